@@ -15,6 +15,7 @@ public class AdvancedSight : ModuleRules
 			new string[]
 			{
 				"Core",
+				"NetCore",
 			}
 		);
 
@@ -27,8 +28,12 @@ public class AdvancedSight : ModuleRules
 				"Slate",
 				"SlateCore",
 				"AIModule",
+				"GameplayTasks",
 				"DeveloperSettings",
+				"PhysicsCore",
 			}
 		);
+
+		SetupGameplayDebuggerSupport(Target);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSense.h"
+
+FAdvancedSenseUpdateContext::FAdvancedSenseUpdateContext(
+	const float InDeltaTime,
+	TConstArrayView<FAdvancedSightActiveListener> InListeners,
+	const TMap<uint32, FAdvancedSightTargetSnapshot>& InTargets,
+	const FAdvancedSightShardGrid& InShardGrid)
+	: DeltaTime(InDeltaTime)
+	, Listeners(InListeners)
+	, Targets(InTargets)
+	, ShardGrid(InShardGrid)
+{
+}
+
+void FAdvancedSenseUpdateContext::GatherTargetsInRadius(
+	const FVector& Location, const float Radius, const AActor* IgnoredActor, TArray<uint32>& OutTargetIds) const
+{
+	const int32 FirstCandidateIndex = OutTargetIds.Num();
+	ShardGrid.GatherTargetIds(Location, Radius, OutTargetIds);
+	const float RadiusSq = FMath::Square(Radius);
+	for (int32 Index = OutTargetIds.Num() - 1; Index >= FirstCandidateIndex; Index--)
+	{
+		const FAdvancedSightTargetSnapshot& Target = Targets[OutTargetIds[Index]];
+		if (Target.Actor == IgnoredActor || FVector::DistSquared(Location, Target.Location) > RadiusSq)
+		{
+			OutTargetIds.RemoveAtSwap(Index);
+		}
+	}
+}
@@ -0,0 +1,98 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSenseHearing.h"
+
+const FName FAdvancedSenseHearing::SenseName = TEXT("Hearing");
+
+void FAdvancedSenseHearing::ReportNoiseEvent(
+	const FVector& Location, const float Loudness, AActor* Instigator, const float MaxRange)
+{
+	FNoiseEvent& NoiseEvent = PendingNoiseEvents.AddDefaulted_GetRef();
+	NoiseEvent.Location = Location;
+	NoiseEvent.Loudness = Loudness;
+	NoiseEvent.MaxRange = MaxRange;
+	NoiseEvent.Instigator = Instigator;
+}
+
+FName FAdvancedSenseHearing::GetSenseName() const
+{
+	return SenseName;
+}
+
+int32 FAdvancedSenseHearing::PrepareUpdate(const FAdvancedSenseUpdateContext& Context)
+{
+	NoiseEvents = MoveTemp(PendingNoiseEvents);
+	PendingNoiseEvents.Reset();
+	if (NoiseEvents.IsEmpty())
+	{
+		return 0;
+	}
+
+	for (FNoiseEvent& NoiseEvent : NoiseEvents)
+	{
+		NoiseEvent.ResolvedInstigator = NoiseEvent.Instigator.Get();
+	}
+
+	HeardNoiseEvents.SetNum(Context.Listeners.Num());
+	for (TArray<int32, TInlineAllocator<4>>& HeardEvents : HeardNoiseEvents)
+	{
+		HeardEvents.Reset();
+	}
+
+	return Context.Listeners.Num();
+}
+
+void FAdvancedSenseHearing::EvaluateWorkItem(const int32 Index, const FAdvancedSenseUpdateContext& Context)
+{
+	const FAdvancedSightActiveListener& Listener = Context.Listeners[Index];
+	const float HearingRadius = Listener.Profile->HearingRadius;
+	if (HearingRadius <= 0.0f)
+	{
+		return;
+	}
+
+	for (int32 EventIndex = 0; EventIndex < NoiseEvents.Num(); EventIndex++)
+	{
+		const FNoiseEvent& NoiseEvent = NoiseEvents[EventIndex];
+		if (NoiseEvent.ResolvedInstigator && NoiseEvent.ResolvedInstigator == Listener.BodyActor)
+		{
+			continue;
+		}
+
+		float Range = HearingRadius * NoiseEvent.Loudness;
+		if (NoiseEvent.MaxRange > 0.0f)
+		{
+			Range = FMath::Min(Range, NoiseEvent.MaxRange);
+		}
+
+		if (FVector::DistSquared(Listener.BodyLocation, NoiseEvent.Location) <= FMath::Square(Range))
+		{
+			HeardNoiseEvents[Index].Add(EventIndex);
+		}
+	}
+}
+
+void FAdvancedSenseHearing::FinishUpdate(
+	const FAdvancedSenseUpdateContext& Context, TArray<FAdvancedSenseEvent>& OutEvents)
+{
+	if (NoiseEvents.IsEmpty())
+	{
+		return;
+	}
+
+	for (int32 Index = 0; Index < Context.Listeners.Num(); Index++)
+	{
+		for (const int32 EventIndex : HeardNoiseEvents[Index])
+		{
+			const FNoiseEvent& NoiseEvent = NoiseEvents[EventIndex];
+			FAdvancedSenseEvent& Event = OutEvents.AddDefaulted_GetRef();
+			Event.ListenerId = Context.Listeners[Index].ListenerId;
+			Event.SourceActor = NoiseEvent.Instigator;
+			Event.SenseName = SenseName;
+			Event.Location = NoiseEvent.Location;
+			Event.Strength = NoiseEvent.Loudness;
+		}
+	}
+
+	NoiseEvents.Reset();
+}
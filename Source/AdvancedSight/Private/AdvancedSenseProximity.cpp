@@ -0,0 +1,112 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSenseProximity.h"
+
+const FName FAdvancedSenseProximity::SenseName = TEXT("Proximity");
+
+FName FAdvancedSenseProximity::GetSenseName() const
+{
+	return SenseName;
+}
+
+int32 FAdvancedSenseProximity::PrepareUpdate(const FAdvancedSenseUpdateContext& Context)
+{
+	CurrentNearbyTargets.SetNum(Context.Listeners.Num());
+	for (TArray<uint32>& Targets : CurrentNearbyTargets)
+	{
+		Targets.Reset();
+	}
+
+	return Context.Listeners.Num();
+}
+
+void FAdvancedSenseProximity::EvaluateWorkItem(const int32 Index, const FAdvancedSenseUpdateContext& Context)
+{
+	const FAdvancedSightActiveListener& Listener = Context.Listeners[Index];
+	if (!Listener.bIsInStaggerGroup || Listener.Profile->ProximityRadius <= 0.0f)
+	{
+		return;
+	}
+
+	TArray<uint32>& Targets = CurrentNearbyTargets[Index];
+	Context.GatherTargetsInRadius(Listener.BodyLocation, Listener.Profile->ProximityRadius, Listener.BodyActor, Targets);
+	Targets.Sort();
+}
+
+void FAdvancedSenseProximity::FinishUpdate(
+	const FAdvancedSenseUpdateContext& Context, TArray<FAdvancedSenseEvent>& OutEvents)
+{
+	for (int32 Index = 0; Index < Context.Listeners.Num(); Index++)
+	{
+		const FAdvancedSightActiveListener& Listener = Context.Listeners[Index];
+		if (!Listener.bIsInStaggerGroup)
+		{
+			continue;
+		}
+
+		TArray<uint32>& Current = CurrentNearbyTargets[Index];
+		TArray<uint32>* Previous = NearbyTargets.Find(Listener.ListenerId);
+		if (!Previous && Current.IsEmpty())
+		{
+			continue;
+		}
+
+		static const TArray<uint32> NoTargets;
+		const TArray<uint32>& PreviousTargets = Previous ? *Previous : NoTargets;
+		auto AddEvent = [&OutEvents, &Context, &Listener](const uint32 TargetId, const bool bIsActive)
+		{
+			FAdvancedSenseEvent& Event = OutEvents.AddDefaulted_GetRef();
+			Event.ListenerId = Listener.ListenerId;
+			Event.TargetId = TargetId;
+			Event.SenseName = SenseName;
+			Event.bIsActive = bIsActive;
+			if (const FAdvancedSightTargetSnapshot* Target = Context.Targets.Find(TargetId))
+			{
+				Event.Location = Target->Location;
+			}
+		};
+
+		// Both lists are sorted, so entered and left targets come out of a single merge
+		int32 CurrentIndex = 0;
+		int32 PreviousIndex = 0;
+		while (CurrentIndex < Current.Num() || PreviousIndex < PreviousTargets.Num())
+		{
+			if (PreviousIndex >= PreviousTargets.Num()
+				|| (CurrentIndex < Current.Num() && Current[CurrentIndex] < PreviousTargets[PreviousIndex]))
+			{
+				AddEvent(Current[CurrentIndex++], true);
+			}
+			else if (CurrentIndex >= Current.Num() || PreviousTargets[PreviousIndex] < Current[CurrentIndex])
+			{
+				AddEvent(PreviousTargets[PreviousIndex++], false);
+			}
+			else
+			{
+				CurrentIndex++;
+				PreviousIndex++;
+			}
+		}
+
+		if (Current.IsEmpty())
+		{
+			NearbyTargets.Remove(Listener.ListenerId);
+		}
+		else
+		{
+			NearbyTargets.Add(Listener.ListenerId, MoveTemp(Current));
+		}
+	}
+}
+
+void FAdvancedSenseProximity::OnListenerRemoved(const uint32 ListenerId)
+{
+	NearbyTargets.Remove(ListenerId);
+}
+
+void FAdvancedSenseProximity::OnTargetRemoved(const uint32 TargetId)
+{
+	for (TTuple<uint32, TArray<uint32>>& Listener : NearbyTargets)
+	{
+		Listener.Value.Remove(TargetId);
+	}
+}
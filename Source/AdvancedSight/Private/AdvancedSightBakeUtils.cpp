@@ -0,0 +1,39 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightBakeUtils.h"
+
+#include "AdvancedSightCommon.h"
+#include "Engine/World.h"
+#include "UObject/Package.h"
+
+UWorld* AdvancedSightBake::LoadWorld(const FString& MapPackageName)
+{
+	UPackage* MapPackage = LoadPackage(nullptr, *MapPackageName, LOAD_None);
+	UWorld* World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Failed to load map %s"), *MapPackageName);
+		return nullptr;
+	}
+
+	World->WorldType = EWorldType::Editor;
+	World->AddToRoot();
+	if (!World->bIsWorldInitialized)
+	{
+		World->InitWorld(UWorld::InitializationValues()
+			.CreatePhysicsScene(true)
+			.EnableTraceCollision(true)
+			.ShouldSimulatePhysics(false)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.AllowAudioPlayback(false));
+	}
+	World->UpdateWorldComponents(true, false);
+	return World;
+}
+
+void AdvancedSightBake::ReleaseWorld(UWorld* World)
+{
+	World->DestroyWorld(false);
+	World->RemoveFromRoot();
+}
@@ -0,0 +1,14 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+namespace AdvancedSightBake
+{
+	// Loads a map with a physics scene so bake commandlets can trace against its geometry
+	UWorld* LoadWorld(const FString& MapPackageName);
+	void ReleaseWorld(UWorld* World);
+}
@@ -3,6 +3,7 @@
 #include "AdvancedSightComponent.h"
 
 #include "AdvancedSightCommon.h"
+#include "AdvancedSightReplicationComponent.h"
 #include "AdvancedSightSystem.h"
 
 UAdvancedSightComponent::UAdvancedSightComponent()
@@ -12,12 +13,52 @@ UAdvancedSightComponent::UAdvancedSightComponent()
 
 FTransform UAdvancedSightComponent::GetEyePointOfViewTransform() const
 {
-	if (const auto* AIController = GetOwner<AController>())
+	const AActor* BodyActor = GetBodyActor();
+	if (!BodyActor)
+	{
+		return GetOwner()->GetTransform();
+	}
+
+	// A body without an eye component is remembered as well, so the fallback does not search its components every call
+	if (CachedEyeBodyActor.Get() != BodyActor || CachedEyeComponent.IsStale())
+	{
+		CachedEyeBodyActor = BodyActor;
+		CachedEyeComponent = FindEyeComponent(BodyActor);
+	}
+
+	if (const USceneComponent* EyeComponent = CachedEyeComponent.Get())
+	{
+		return EyeSocketName.IsNone()
+			? EyeComponent->GetComponentTransform()
+			: EyeComponent->GetSocketTransform(EyeSocketName);
+	}
+
+	FVector EyeLocation;
+	FRotator EyeRotation;
+	BodyActor->GetActorEyesViewPoint(EyeLocation, EyeRotation);
+	return FTransform(EyeRotation, EyeLocation);
+}
+
+const USceneComponent* UAdvancedSightComponent::FindEyeComponent(const AActor* BodyActor) const
+{
+	if (!EyeComponentTag.IsNone())
+	{
+		return BodyActor->FindComponentByTag<USceneComponent>(EyeComponentTag);
+	}
+
+	if (!EyeSocketName.IsNone())
 	{
-		return AIController->GetPawn()->GetActorTransform();
+		TInlineComponentArray<USceneComponent*> SceneComponents(BodyActor);
+		for (const USceneComponent* SceneComponent : SceneComponents)
+		{
+			if (SceneComponent->DoesSocketExist(EyeSocketName))
+			{
+				return SceneComponent;
+			}
+		}
 	}
 
-	return GetOwner()->GetTransform();
+	return nullptr;
 }
 
 AActor* UAdvancedSightComponent::GetBodyActor() const
@@ -30,17 +71,65 @@ AActor* UAdvancedSightComponent::GetBodyActor() const
 	return GetOwner();
 }
 
+void UAdvancedSightComponent::SetTargetCategoryEnabled(const EAdvancedSightTargetCategory Category, const bool bEnabled)
+{
+	const uint8 NewSubscribedCategories = bEnabled
+		? SubscribedCategories | static_cast<uint8>(Category)
+		: SubscribedCategories & ~static_cast<uint8>(Category);
+	if (NewSubscribedCategories == SubscribedCategories)
+	{
+		return;
+	}
+
+	SubscribedCategories = NewSubscribedCategories;
+	if (AdvancedSightSystem.IsValid())
+	{
+		AdvancedSightSystem->UpdateListenerCategories(this);
+	}
+}
+
+bool UAdvancedSightComponent::IsTargetCategoryEnabled(const EAdvancedSightTargetCategory Category) const
+{
+	return (SubscribedCategories & static_cast<uint8>(Category)) != 0;
+}
+
+uint8 UAdvancedSightComponent::GetSubscribedCategories() const
+{
+	return SubscribedCategories;
+}
+
+void UAdvancedSightComponent::AddIgnoredActors(FCollisionQueryParams& QueryParams) const
+{
+	AActor* BodyActor = GetBodyActor();
+	if (!BodyActor)
+	{
+		return;
+	}
+
+	QueryParams.AddIgnoredActor(BodyActor);
+	if (bIgnoreAttachedActors)
+	{
+		TArray<AActor*> AttachedActors;
+		BodyActor->GetAttachedActors(AttachedActors, true, true);
+		QueryParams.AddIgnoredActors(AttachedActors);
+	}
+}
+
 void UAdvancedSightComponent::SpotTarget(AActor* TargetActor)
 {
 	SpottedTargets.Add(TargetActor);
+	UpdateReplicatedTarget(TargetActor);
 	OnTargetSpotted.Broadcast(TargetActor);
+	OnTargetTransition.Broadcast(TargetActor, EAdvancedSightTransition::Spotted);
 }
 
 void UAdvancedSightComponent::PerceiveTarget(AActor* TargetActor)
 {
 	SpottedTargets.RemoveSwap(TargetActor);
 	PerceivedTargets.Add(TargetActor);
+	UpdateReplicatedTarget(TargetActor);
 	OnTargetPerceived.Broadcast(TargetActor);
+	OnTargetTransition.Broadcast(TargetActor, EAdvancedSightTransition::Perceived);
 }
 
 void UAdvancedSightComponent::LoseTarget(AActor* TargetActor)
@@ -55,13 +144,111 @@ void UAdvancedSightComponent::LoseTarget(AActor* TargetActor)
 		RememberedTargets.Add(TargetActor);
 	}
 	
+	UpdateReplicatedTarget(TargetActor);
 	OnTargetLost.Broadcast(TargetActor);
+	OnTargetTransition.Broadcast(TargetActor, EAdvancedSightTransition::Lost);
 }
 
 void UAdvancedSightComponent::ForgetTarget(AActor* TargetActor)
 {
 	RememberedTargets.RemoveSwap(TargetActor);
+	UpdateReplicatedTarget(TargetActor);
 	OnTargetForgot.Broadcast(TargetActor);
+	OnTargetTransition.Broadcast(TargetActor, EAdvancedSightTransition::Forgot);
+}
+
+void UAdvancedSightComponent::RestoreTargets(
+	TArray<AActor*>&& InPerceivedTargets, TArray<AActor*>&& InSpottedTargets, TArray<AActor*>&& InRememberedTargets)
+{
+	TSet<AActor*> AffectedTargets;
+	auto AddAffectedTargets = [this, &AffectedTargets]()
+	{
+		for (const TArray<TObjectPtr<AActor>>* Targets : { &PerceivedTargets, &SpottedTargets, &RememberedTargets })
+		{
+			for (AActor* TargetActor : *Targets)
+			{
+				AffectedTargets.Add(TargetActor);
+			}
+		}
+	};
+	AddAffectedTargets();
+
+	PerceivedTargets = MoveTemp(InPerceivedTargets);
+	SpottedTargets = MoveTemp(InSpottedTargets);
+	RememberedTargets = MoveTemp(InRememberedTargets);
+
+	AddAffectedTargets();
+	for (AActor* TargetActor : AffectedTargets)
+	{
+		UpdateReplicatedTarget(TargetActor);
+	}
+}
+
+void UAdvancedSightComponent::SetQuantizedGain(AActor* TargetActor, const uint8 QuantizedGain)
+{
+	OnTargetGainChanged.Broadcast(TargetActor, FAdvancedSightReplicatedTarget::DequantizeGain(QuantizedGain));
+	if (UAdvancedSightReplicationComponent* ReplicationComponent = GetReplicationComponent())
+	{
+		ReplicationComponent->SetQuantizedGain(TargetActor, QuantizedGain);
+	}
+}
+
+void UAdvancedSightComponent::ReceiveStimulus(const FAdvancedSenseStimulus& Stimulus)
+{
+	OnSenseStimulus.Broadcast(Stimulus);
+}
+
+UAdvancedSightReplicationComponent* UAdvancedSightComponent::GetReplicationComponent()
+{
+	AActor* BodyActor = bReplicatePerceptionState && GetOwnerRole() == ROLE_Authority && GetNetMode() != NM_Standalone
+		? GetBodyActor()
+		: nullptr;
+	UAdvancedSightReplicationComponent* ReplicationComponent = CachedReplicationComponent.Get();
+	if (ReplicationComponent && ReplicationComponent->GetOwner() == BodyActor)
+	{
+		return ReplicationComponent;
+	}
+
+	// The previous body keeps no state of a listener that no longer drives it
+	if (ReplicationComponent)
+	{
+		ReplicationComponent->ResetTargets();
+	}
+	CachedReplicationComponent.Reset();
+	if (!BodyActor || !BodyActor->GetIsReplicated())
+	{
+		return nullptr;
+	}
+
+	ReplicationComponent = BodyActor->FindComponentByClass<UAdvancedSightReplicationComponent>();
+	if (!ReplicationComponent)
+	{
+		ReplicationComponent = NewObject<UAdvancedSightReplicationComponent>(BodyActor);
+		ReplicationComponent->RegisterComponent();
+	}
+	CachedReplicationComponent = ReplicationComponent;
+
+	for (const TArray<TObjectPtr<AActor>>* Targets : { &PerceivedTargets, &SpottedTargets, &RememberedTargets })
+	{
+		for (AActor* TargetActor : *Targets)
+		{
+			const float GainValue = AdvancedSightSystem.IsValid()
+				? AdvancedSightSystem->GetGainValueForTarget(GetUniqueID(), TargetActor->GetUniqueID())
+				: 0.0f;
+			ReplicationComponent->SetTarget(
+				TargetActor, GetTargetState(TargetActor), FAdvancedSightReplicatedTarget::QuantizeGain(GainValue));
+		}
+	}
+
+	return ReplicationComponent;
+}
+
+void UAdvancedSightComponent::UpdateReplicatedTarget(AActor* TargetActor)
+{
+	if (UAdvancedSightReplicationComponent* ReplicationComponent = GetReplicationComponent())
+	{
+		ReplicationComponent->SetTargetState(TargetActor, GetTargetState(TargetActor));
+	}
 }
 
 const TArray<AActor*>& UAdvancedSightComponent::GetPerceivedTargets() const
@@ -79,6 +266,54 @@ const TArray<AActor*>& UAdvancedSightComponent::GetRememberedTargets() const
 	return RememberedTargets;
 }
 
+EAdvancedSightTargetState UAdvancedSightComponent::GetTargetState(const AActor* TargetActor) const
+{
+	EAdvancedSightTargetState State = EAdvancedSightTargetState::None;
+	if (SpottedTargets.Contains(TargetActor))
+	{
+		State |= EAdvancedSightTargetState::Spotted;
+	}
+
+	if (PerceivedTargets.Contains(TargetActor))
+	{
+		State |= EAdvancedSightTargetState::Perceived;
+	}
+
+	if (RememberedTargets.Contains(TargetActor))
+	{
+		State |= EAdvancedSightTargetState::Remembered;
+	}
+
+	return State;
+}
+
+UAdvancedSightComponent* UAdvancedSightComponent::FindSightComponent(const AActor* Actor)
+{
+	if (!Actor)
+	{
+		return nullptr;
+	}
+
+	if (auto* SightComponent = Actor->FindComponentByClass<UAdvancedSightComponent>())
+	{
+		return SightComponent;
+	}
+
+	if (const auto* Controller = Cast<AController>(Actor))
+	{
+		const APawn* Pawn = Controller->GetPawn();
+		return Pawn ? Pawn->FindComponentByClass<UAdvancedSightComponent>() : nullptr;
+	}
+
+	if (const auto* Pawn = Cast<APawn>(Actor))
+	{
+		const AController* Controller = Pawn->GetController();
+		return Controller ? Controller->FindComponentByClass<UAdvancedSightComponent>() : nullptr;
+	}
+
+	return nullptr;
+}
+
 bool UAdvancedSightComponent::IsTargetPerceived(const AActor* TargetActor) const
 {
 	return PerceivedTargets.Contains(TargetActor);
@@ -95,15 +330,40 @@ float UAdvancedSightComponent::GetGainValueForTarget(const AActor* TargetActor)
 		return -1.0f;
 	}
 
+	if (GetOwnerRole() != ROLE_Authority)
+	{
+		const AActor* BodyActor = GetBodyActor();
+		const UAdvancedSightReplicationComponent* ReplicationComponent = BodyActor
+			? BodyActor->FindComponentByClass<UAdvancedSightReplicationComponent>()
+			: nullptr;
+		return ReplicationComponent ? ReplicationComponent->GetGainValueForTarget(TargetActor) : 0.0f;
+	}
+
 	const float GainValue =
 			AdvancedSightSystem->GetGainValueForTarget(GetUniqueID(), TargetActor->GetUniqueID());
 	return GainValue;
 }
 
+FVector UAdvancedSightComponent::GetLastKnownLocation(const AActor* TargetActor) const
+{
+	if (!TargetActor || !AdvancedSightSystem.IsValid())
+	{
+		return FVector::ZeroVector;
+	}
+
+	return AdvancedSightSystem->GetLastKnownLocationFor(GetUniqueID(), TargetActor->GetUniqueID());
+}
+
 void UAdvancedSightComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
+	if (GetOwnerRole() != ROLE_Authority)
+	{
+		return;
+	}
+
+	SubscribedCategories = SightData ? static_cast<uint8>(SightData->SubscribedCategories) : 0;
 	AdvancedSightSystem = GetWorld()->GetSubsystem<UAdvancedSightSystem>();
 	if (ensureMsgf(AdvancedSightSystem.IsValid(), TEXT("Advanced sight system reference is invalid")))
 	{
@@ -119,6 +379,11 @@ void UAdvancedSightComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 		AdvancedSightSystem->UnregisterListener(this);
 	}
 
+	if (UAdvancedSightReplicationComponent* ReplicationComponent = CachedReplicationComponent.Get())
+	{
+		ReplicationComponent->ResetTargets();
+	}
+
 	Super::EndPlay(EndPlayReason);
 }
 
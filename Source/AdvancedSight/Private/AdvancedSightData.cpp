@@ -1,3 +1,116 @@
 ﻿// Copyright 2024, Robert Lewicki, All rights reserved.
 
 #include "AdvancedSightData.h"
+
+namespace AdvancedSightData
+{
+	static const FRichCurve* GetCurveIfSet(const FRuntimeFloatCurve& Curve)
+	{
+		const FRichCurve* RichCurve = Curve.GetRichCurveConst();
+		return RichCurve && RichCurve->GetNumKeys() > 0 ? RichCurve : nullptr;
+	}
+
+	static float SampleTable(const float* Samples, const float Alpha)
+	{
+		const float Position = FMath::Clamp(Alpha, 0.0f, 1.0f) * (FAdvancedSightGainTable::NumSamples - 1);
+		const int32 Index = FMath::Min(static_cast<int32>(Position), FAdvancedSightGainTable::NumSamples - 2);
+		return FMath::Lerp(Samples[Index], Samples[Index + 1], Position - Index);
+	}
+}
+
+void FAdvancedSightGainTable::Bake(const FRichCurve* DistanceCurve, const FRichCurve* AngleCurve)
+{
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		const float Alpha = static_cast<float>(Index) / (NumSamples - 1);
+		DistanceSamples[Index] = DistanceCurve ? DistanceCurve->Eval(Alpha, 1.0f) : 1.0f;
+		AngleSamples[Index] = AngleCurve ? AngleCurve->Eval(Alpha, 1.0f) : 1.0f;
+	}
+}
+
+float FAdvancedSightGainTable::Sample(const float NormalizedDistance, const float NormalizedAngle) const
+{
+	return AdvancedSightData::SampleTable(DistanceSamples, NormalizedDistance)
+		* AdvancedSightData::SampleTable(AngleSamples, NormalizedAngle);
+}
+
+void FAdvancedSightCone::CacheShapeData()
+{
+	// Frustum and ellipse tests only work in front of the eyes
+	const bool bIsFrontOnly = Shape == EAdvancedSightConeShape::Frustum || Shape == EAdvancedSightConeShape::Ellipse;
+	const float HalfFOV = FMath::DegreesToRadians(bIsFrontOnly ? FMath::Min(FOV, 179.0f) : FOV) / 2.0f;
+	const float HalfVerticalFOV = FMath::DegreesToRadians(FMath::Min(VerticalFOV, 179.0f)) / 2.0f;
+	CosHalfFOV = FMath::Cos(HalfFOV);
+	TanHalfFOV = FMath::Tan(HalfFOV);
+	TanHalfVerticalFOV = FMath::Tan(HalfVerticalFOV);
+}
+
+float FAdvancedSightCone::GetReach() const
+{
+	return Shape == EAdvancedSightConeShape::Box
+		? FVector(GainRadius, BoxHalfSize.X, BoxHalfSize.Y).Size()
+		: GainRadius;
+}
+
+void UAdvancedSightData::PostLoad()
+{
+	Super::PostLoad();
+
+	BakeCones();
+}
+
+#if WITH_EDITOR
+void UAdvancedSightData::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	BakeCones();
+}
+#endif
+
+void UAdvancedSightData::ConditionalBakeCones()
+{
+	if (Cones.Num() != SightInfos.Num())
+	{
+		BakeCones();
+	}
+}
+
+const TArray<FAdvancedSightCone>& UAdvancedSightData::GetCones() const
+{
+	return Cones;
+}
+
+void UAdvancedSightData::BakeCones()
+{
+	const FRichCurve* DefaultDistanceCurve = AdvancedSightData::GetCurveIfSet(DistanceGainCurve);
+	const FRichCurve* DefaultAngleCurve = AdvancedSightData::GetCurveIfSet(AngleGainCurve);
+	Cones.Reset(SightInfos.Num());
+	for (const FAdvancedSightInfo& SightInfo : SightInfos)
+	{
+		FAdvancedSightCone& Cone = Cones.AddDefaulted_GetRef();
+		Cone.Shape = SightInfo.Shape;
+		Cone.GainRadius = SightInfo.GainRadius;
+		Cone.FOV = SightInfo.FOV;
+		Cone.VerticalFOV = SightInfo.VerticalFOV;
+		Cone.BoxHalfSize = SightInfo.BoxHalfSize;
+		Cone.GainMultiplier = SightInfo.GainMultiplier;
+		Cone.CacheShapeData();
+
+		const FRichCurve* DistanceCurve = AdvancedSightData::GetCurveIfSet(SightInfo.DistanceGainCurve);
+		const FRichCurve* AngleCurve = AdvancedSightData::GetCurveIfSet(SightInfo.AngleGainCurve);
+		DistanceCurve = DistanceCurve ? DistanceCurve : DefaultDistanceCurve;
+		AngleCurve = AngleCurve ? AngleCurve : DefaultAngleCurve;
+		if (DistanceCurve || AngleCurve)
+		{
+			TSharedRef<FAdvancedSightGainTable> GainTable = MakeShared<FAdvancedSightGainTable>();
+			GainTable->Bake(DistanceCurve, AngleCurve);
+			Cone.GainTable = GainTable;
+		}
+	}
+
+	Cones.Sort([](const FAdvancedSightCone& Lhs, const FAdvancedSightCone& Rhs)
+	{
+		return Lhs.GainRadius < Rhs.GainRadius;
+	});
+}
@@ -0,0 +1,65 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightGrid.h"
+
+FAdvancedSightGridLayout FAdvancedSightGridLayout::MakeFromBounds(const FBox& Bounds, const float InCellSize)
+{
+	FAdvancedSightGridLayout Layout;
+	if (!Bounds.IsValid || InCellSize <= 0.0f)
+	{
+		return Layout;
+	}
+
+	const FVector Size = Bounds.GetSize();
+	Layout.Origin = Bounds.Min;
+	Layout.CellSize = InCellSize;
+	Layout.Dimensions.X = FMath::Max(FMath::CeilToInt(Size.X / InCellSize), 1);
+	Layout.Dimensions.Y = FMath::Max(FMath::CeilToInt(Size.Y / InCellSize), 1);
+	Layout.Dimensions.Z = FMath::Max(FMath::CeilToInt(Size.Z / InCellSize), 1);
+	return Layout;
+}
+
+bool FAdvancedSightGridLayout::IsValid() const
+{
+	return CellSize > 0.0f && Dimensions.X > 0 && Dimensions.Y > 0 && Dimensions.Z > 0;
+}
+
+int32 FAdvancedSightGridLayout::GetNumCells() const
+{
+	return IsValid() ? Dimensions.X * Dimensions.Y * Dimensions.Z : 0;
+}
+
+int32 FAdvancedSightGridLayout::GetCellIndex(const FVector& Location) const
+{
+	const FVector LocalLocation = (Location - Origin) / CellSize;
+	const int32 X = FMath::FloorToInt(LocalLocation.X);
+	const int32 Y = FMath::FloorToInt(LocalLocation.Y);
+	const int32 Z = FMath::FloorToInt(LocalLocation.Z);
+	if (X < 0 || Y < 0 || Z < 0 || X >= Dimensions.X || Y >= Dimensions.Y || Z >= Dimensions.Z)
+	{
+		return INDEX_NONE;
+	}
+
+	return X + Dimensions.X * (Y + Dimensions.Y * Z);
+}
+
+FVector FAdvancedSightGridLayout::GetCellCenter(const int32 CellIndex) const
+{
+	const int32 X = CellIndex % Dimensions.X;
+	const int32 Y = CellIndex / Dimensions.X % Dimensions.Y;
+	const int32 Z = CellIndex / (Dimensions.X * Dimensions.Y);
+	return Origin + (FVector(X, Y, Z) + 0.5f) * CellSize;
+}
+
+FBox FAdvancedSightGridLayout::GetBounds() const
+{
+	return FBox(Origin, Origin + FVector(Dimensions) * CellSize);
+}
+
+FArchive& operator<<(FArchive& Ar, FAdvancedSightGridLayout& Layout)
+{
+	Ar << Layout.Origin;
+	Ar << Layout.CellSize;
+	Ar << Layout.Dimensions;
+	return Ar;
+}
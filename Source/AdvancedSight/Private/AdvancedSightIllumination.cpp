@@ -0,0 +1,44 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightIllumination.h"
+
+#include "AdvancedSightIlluminationGrid.h"
+
+void FAdvancedSightIllumination::Reset()
+{
+	Grids.Reset();
+	LightVolumes.Reset();
+}
+
+float FAdvancedSightIllumination::Sample(const FVector& Location) const
+{
+	float Illumination = 1.0f;
+	for (const UAdvancedSightIlluminationGrid* Grid : Grids)
+	{
+		if (Grid->TrySample(Location, Illumination))
+		{
+			break;
+		}
+	}
+
+	for (const FAdvancedSightLightVolume& LightVolume : LightVolumes)
+	{
+		const float DistanceSq = FVector::DistSquared(Location, LightVolume.Location);
+		if (DistanceSq < LightVolume.RadiusSq)
+		{
+			Illumination += LightVolume.Illumination * FMath::Square(1.0f - DistanceSq / LightVolume.RadiusSq);
+		}
+	}
+
+	return FMath::Clamp(Illumination, 0.0f, 1.0f);
+}
+
+uint8 FAdvancedSightIllumination::Quantize(const float Illumination)
+{
+	return static_cast<uint8>(FMath::RoundToInt(FMath::Clamp(Illumination, 0.0f, 1.0f) * 255.0f));
+}
+
+float FAdvancedSightIllumination::Dequantize(const uint8 QuantizedIllumination)
+{
+	return QuantizedIllumination / 255.0f;
+}
@@ -0,0 +1,203 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightIlluminationBakeCommandlet.h"
+
+#include "AdvancedSightBakeUtils.h"
+#include "AdvancedSightCommon.h"
+#include "AdvancedSightIllumination.h"
+#include "AdvancedSightIlluminationGrid.h"
+#include "AdvancedSightIlluminationVolume.h"
+#include "Async/ParallelFor.h"
+#include "Components/DirectionalLightComponent.h"
+#include "Components/LocalLightComponent.h"
+#include "Components/SpotLightComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+#include "UObject/SavePackage.h"
+
+namespace AdvancedSightIlluminationBake
+{
+	static constexpr float DirectionalLightTraceDistance = 100000.0f;
+
+	struct FBakeLight
+	{
+		FVector Location = FVector::ZeroVector;
+		FVector Direction = FVector::ForwardVector;
+		float Radius = 0.0f;
+		float Brightness = 0.0f;
+		float CosOuterConeAngle = -1.0f;
+		bool bIsDirectional = false;
+		const AActor* Owner = nullptr;
+	};
+
+	static void GatherLights(const UWorld* World, TArray<FBakeLight>& OutLights)
+	{
+		for (TObjectIterator<ULightComponent> It; It; ++It)
+		{
+			const ULightComponent* LightComponent = *It;
+			if (LightComponent->GetWorld() != World || !LightComponent->IsVisible() || !LightComponent->bAffectsWorld)
+			{
+				continue;
+			}
+
+			FBakeLight& Light = OutLights.AddDefaulted_GetRef();
+			Light.Location = LightComponent->GetComponentLocation();
+			Light.Direction = LightComponent->GetDirection();
+			Light.Brightness = LightComponent->Intensity * FLinearColor(LightComponent->LightColor).GetLuminance();
+			Light.Owner = LightComponent->GetOwner();
+			if (LightComponent->IsA<UDirectionalLightComponent>())
+			{
+				Light.bIsDirectional = true;
+			}
+			else if (const auto* LocalLightComponent = Cast<ULocalLightComponent>(LightComponent))
+			{
+				Light.Radius = LocalLightComponent->AttenuationRadius;
+			}
+
+			if (const auto* SpotLightComponent = Cast<USpotLightComponent>(LightComponent))
+			{
+				Light.CosOuterConeAngle = FMath::Cos(FMath::DegreesToRadians(SpotLightComponent->OuterConeAngle));
+			}
+		}
+	}
+}
+
+UAdvancedSightIlluminationBakeCommandlet::UAdvancedSightIlluminationBakeCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UAdvancedSightIlluminationBakeCommandlet::Main(const FString& Params)
+{
+#if WITH_EDITOR
+	FString MapPackageName;
+	if (!FParse::Value(*Params, TEXT("Map="), MapPackageName))
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Missing -Map=<map package name> argument"));
+		return 1;
+	}
+
+	UWorld* World = AdvancedSightBake::LoadWorld(MapPackageName);
+	if (!World)
+	{
+		return 1;
+	}
+
+	FSavePackageArgs SaveArgs;
+	SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+	bool bIsMapModified = false;
+	int32 Result = 0;
+	for (TActorIterator<AAdvancedSightIlluminationVolume> It(World); It; ++It)
+	{
+		AAdvancedSightIlluminationVolume* Volume = *It;
+		if (!Volume->IlluminationGrid)
+		{
+			const FString GridPackageName = FString::Printf(
+				TEXT("%s_Illumination_%s"), *MapPackageName, *Volume->GetActorNameOrLabel());
+			UPackage* GridPackage = CreatePackage(*GridPackageName);
+			Volume->Modify();
+			Volume->IlluminationGrid = NewObject<UAdvancedSightIlluminationGrid>(
+				GridPackage, *FPackageName::GetShortName(GridPackageName), RF_Public | RF_Standalone);
+			bIsMapModified = true;
+		}
+
+		UAdvancedSightIlluminationGrid* Grid = Volume->IlluminationGrid;
+		BakeVolume(World, Volume, Grid);
+		Grid->MarkPackageDirty();
+
+		UPackage* GridPackage = Grid->GetPackage();
+		const FString GridFilename = FPackageName::LongPackageNameToFilename(
+			GridPackage->GetName(), FPackageName::GetAssetPackageExtension());
+		if (!UPackage::SavePackage(GridPackage, Grid, *GridFilename, SaveArgs))
+		{
+			UE_LOG(LogAdvancedSight, Error, TEXT("Failed to save illumination grid %s"), *GridFilename);
+			Result = 1;
+			continue;
+		}
+
+		UE_LOG(
+			LogAdvancedSight,
+			Display,
+			TEXT("Baked %d illumination cells of %s into %s"),
+			Grid->Cells.Num(),
+			*Volume->GetActorNameOrLabel(),
+			*GridPackage->GetName());
+	}
+
+	if (bIsMapModified)
+	{
+		SaveArgs.TopLevelFlags = RF_Standalone;
+		const FString MapFilename = FPackageName::LongPackageNameToFilename(
+			MapPackageName, FPackageName::GetMapPackageExtension());
+		if (!UPackage::SavePackage(World->GetPackage(), World, *MapFilename, SaveArgs))
+		{
+			UE_LOG(LogAdvancedSight, Error, TEXT("Failed to save map %s"), *MapFilename);
+			Result = 1;
+		}
+	}
+
+	AdvancedSightBake::ReleaseWorld(World);
+	return Result;
+#else
+	UE_LOG(LogAdvancedSight, Error, TEXT("Illumination grids can only be baked with editor data"));
+	return 1;
+#endif
+}
+
+void UAdvancedSightIlluminationBakeCommandlet::BakeVolume(
+	const UWorld* World, const AAdvancedSightIlluminationVolume* Volume, UAdvancedSightIlluminationGrid* Grid)
+{
+	using namespace AdvancedSightIlluminationBake;
+
+	TArray<FBakeLight> Lights;
+	GatherLights(World, Lights);
+
+	Grid->Layout = FAdvancedSightGridLayout::MakeFromBounds(Volume->GetComponentsBoundingBox(true), Volume->CellSize);
+	Grid->Cells.SetNumZeroed(Grid->Layout.GetNumCells());
+	const float InverseFullyLitIntensity = Volume->FullyLitIntensity > 0.0f ? 1.0f / Volume->FullyLitIntensity : 0.0f;
+	ParallelFor(Grid->Cells.Num(), [World, Volume, Grid, &Lights, InverseFullyLitIntensity](int32 CellIndex)
+	{
+		const FVector CellCenter = Grid->Layout.GetCellCenter(CellIndex);
+		float Illumination = Volume->AmbientIllumination;
+		for (const FBakeLight& Light : Lights)
+		{
+			FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(AdvancedSightIlluminationBake), false, Light.Owner);
+			if (Light.bIsDirectional)
+			{
+				const FVector TraceEnd = CellCenter - Light.Direction * DirectionalLightTraceDistance;
+				if (!World->LineTraceTestByChannel(CellCenter, TraceEnd, ECC_Visibility, QueryParams))
+				{
+					Illumination += Volume->DirectionalLightIllumination;
+				}
+				continue;
+			}
+
+			const FVector ToCell = CellCenter - Light.Location;
+			const float DistanceSq = ToCell.SizeSquared();
+			if (DistanceSq >= FMath::Square(Light.Radius))
+			{
+				continue;
+			}
+
+			if (FVector::DotProduct(ToCell.GetSafeNormal(), Light.Direction) < Light.CosOuterConeAngle)
+			{
+				continue;
+			}
+
+			if (World->LineTraceTestByChannel(CellCenter, Light.Location, ECC_Visibility, QueryParams))
+			{
+				continue;
+			}
+
+			const float Falloff = FMath::Square(1.0f - DistanceSq / FMath::Square(Light.Radius));
+			Illumination += Light.Brightness * InverseFullyLitIntensity * Falloff;
+		}
+
+		Grid->Cells[CellIndex] = FAdvancedSightIllumination::Quantize(Illumination);
+	});
+}
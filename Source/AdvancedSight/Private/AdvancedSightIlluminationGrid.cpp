@@ -0,0 +1,15 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightIlluminationGrid.h"
+
+bool UAdvancedSightIlluminationGrid::TrySample(const FVector& Location, float& OutIllumination) const
+{
+	const int32 CellIndex = Layout.GetCellIndex(Location);
+	if (!Cells.IsValidIndex(CellIndex))
+	{
+		return false;
+	}
+
+	OutIllumination = Cells[CellIndex] / 255.0f;
+	return true;
+}
@@ -0,0 +1,36 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightIlluminationVolume.h"
+
+#include "AdvancedSightIlluminationGrid.h"
+#include "AdvancedSightSystem.h"
+#include "Components/BrushComponent.h"
+
+AAdvancedSightIlluminationVolume::AAdvancedSightIlluminationVolume()
+{
+	GetBrushComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	bColored = true;
+	BrushColor = FColor(255, 200, 40);
+}
+
+void AAdvancedSightIlluminationVolume::BeginPlay()
+{
+	Super::BeginPlay();
+
+	auto* SightSystem = GetWorld()->GetSubsystem<UAdvancedSightSystem>();
+	if (SightSystem && IlluminationGrid)
+	{
+		SightSystem->RegisterIlluminationGrid(IlluminationGrid);
+	}
+}
+
+void AAdvancedSightIlluminationVolume::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	auto* SightSystem = GetWorld()->GetSubsystem<UAdvancedSightSystem>();
+	if (SightSystem && IlluminationGrid)
+	{
+		SightSystem->UnregisterIlluminationGrid(IlluminationGrid);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
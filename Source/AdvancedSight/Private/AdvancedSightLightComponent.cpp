@@ -0,0 +1,41 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightLightComponent.h"
+
+#include "AdvancedSightSystem.h"
+
+UAdvancedSightLightComponent::UAdvancedSightLightComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UAdvancedSightLightComponent::SetLightEnabled(const bool bEnabled)
+{
+	bIsLightEnabled = bEnabled;
+}
+
+bool UAdvancedSightLightComponent::IsLightEnabled() const
+{
+	return bIsLightEnabled;
+}
+
+void UAdvancedSightLightComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	AdvancedSightSystem = GetWorld()->GetSubsystem<UAdvancedSightSystem>();
+	if (AdvancedSightSystem.IsValid())
+	{
+		AdvancedSightSystem->RegisterLight(this);
+	}
+}
+
+void UAdvancedSightLightComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (AdvancedSightSystem.IsValid())
+	{
+		AdvancedSightSystem->UnregisterLight(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
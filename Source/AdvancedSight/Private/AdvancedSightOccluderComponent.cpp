@@ -0,0 +1,45 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightOccluderComponent.h"
+
+#include "AdvancedSightSystem.h"
+
+UAdvancedSightOccluderComponent::UAdvancedSightOccluderComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UAdvancedSightOccluderComponent::SetTransmittance(const float InTransmittance)
+{
+	Transmittance = FMath::Clamp(InTransmittance, 0.0f, 1.0f);
+	if (AdvancedSightSystem.IsValid())
+	{
+		AdvancedSightSystem->RegisterOccluder(this);
+	}
+}
+
+float UAdvancedSightOccluderComponent::GetTransmittance() const
+{
+	return Transmittance;
+}
+
+void UAdvancedSightOccluderComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	AdvancedSightSystem = GetWorld()->GetSubsystem<UAdvancedSightSystem>();
+	if (AdvancedSightSystem.IsValid())
+	{
+		AdvancedSightSystem->RegisterOccluder(this);
+	}
+}
+
+void UAdvancedSightOccluderComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (AdvancedSightSystem.IsValid())
+	{
+		AdvancedSightSystem->UnregisterOccluder(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
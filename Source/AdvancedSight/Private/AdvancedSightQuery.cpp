@@ -0,0 +1,61 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightQuery.h"
+
+void FAdvancedSightListenerProfile::SetCones(const TArray<FAdvancedSightCone>& InCones)
+{
+	Cones = InCones;
+	BuildConeBatches();
+}
+
+void FAdvancedSightListenerProfile::BuildConeBatches()
+{
+	check(Cones.Num() <= MAX_uint8 + 1);
+	ConeIndicesByShape.Reset(Cones.Num());
+	for (int32 Index = 0; Index < Cones.Num(); Index++)
+	{
+		ConeIndicesByShape.Add(static_cast<uint8>(Index));
+	}
+
+	ConeIndicesByShape.StableSort([this](const uint8 Lhs, const uint8 Rhs)
+	{
+		return Cones[Lhs].Shape < Cones[Rhs].Shape;
+	});
+
+	ConeBatches.Reset();
+	for (int32 Index = 0; Index < ConeIndicesByShape.Num(); Index++)
+	{
+		const EAdvancedSightConeShape Shape = Cones[ConeIndicesByShape[Index]].Shape;
+		if (ConeBatches.IsEmpty() || ConeBatches.Last().Shape != Shape)
+		{
+			ConeBatches.Add({ Shape, Index, 0 });
+		}
+		ConeBatches.Last().NumCones++;
+	}
+}
+
+void FAdvancedSightListenerProfile::SetCategoryTuning(const TArray<FAdvancedSightCategoryTuning>& CategoryTuning)
+{
+	for (FAdvancedSightCategoryProfile& Category : Categories)
+	{
+		Category = { 1.0f, LoseSightRadius, LoseSightCooldown };
+	}
+
+	for (const FAdvancedSightCategoryTuning& Tuning : CategoryTuning)
+	{
+		if (Tuning.Category == EAdvancedSightTargetCategory::None)
+		{
+			continue;
+		}
+
+		FAdvancedSightCategoryProfile& Category = Categories[GetCategoryIndex(static_cast<uint8>(Tuning.Category))];
+		Category.GainMultiplier = Tuning.GainMultiplier;
+		Category.LoseSightRadius = LoseSightRadius * Tuning.LoseSightRadiusMultiplier;
+		Category.LoseSightCooldown = LoseSightCooldown * Tuning.LoseSightCooldownMultiplier;
+	}
+}
+
+uint8 FAdvancedSightListenerProfile::GetCategoryIndex(const uint8 Categories)
+{
+	return Categories != 0 ? static_cast<uint8>(FMath::CountTrailingZeros(static_cast<uint32>(Categories))) : 0;
+}
@@ -0,0 +1,539 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightRecording.h"
+
+#include "AdvancedSightCommon.h"
+#include "AdvancedSightSystem.h"
+#include "Async/MappedFileHandle.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Memory/MemoryView.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace AdvancedSightRecording
+{
+	static constexpr uint32 Magic = 0x43525341; // "ASRC"
+	static constexpr uint32 Version = 7;
+	static constexpr int64 HeaderSize = sizeof(Magic) + sizeof(Version);
+}
+
+FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedProfile& Profile)
+{
+	Ar << Profile.ListenerId;
+	Ar << Profile.LoseSightRadius;
+	Ar << Profile.LoseSightCooldown;
+	Ar << Profile.DarknessGainMultiplier;
+	int32 NumCones = Profile.Cones.Num();
+	Ar << NumCones;
+	if (Ar.IsLoading())
+	{
+		Profile.Cones.SetNum(NumCones);
+	}
+
+	for (FAdvancedSightCone& Cone : Profile.Cones)
+	{
+		uint8 Shape = static_cast<uint8>(Cone.Shape);
+		Ar << Shape;
+		Cone.Shape = static_cast<EAdvancedSightConeShape>(Shape);
+		Ar << Cone.GainRadius;
+		Ar << Cone.FOV;
+		Ar << Cone.VerticalFOV;
+		Ar << Cone.BoxHalfSize;
+		Ar << Cone.GainMultiplier;
+		if (Ar.IsLoading())
+		{
+			Cone.CacheShapeData();
+		}
+
+		bool bHasGainTable = Cone.GainTable.IsValid();
+		Ar << bHasGainTable;
+		if (!bHasGainTable)
+		{
+			continue;
+		}
+
+		if (Ar.IsLoading())
+		{
+			TSharedRef<FAdvancedSightGainTable> GainTable = MakeShared<FAdvancedSightGainTable>();
+			Ar.Serialize(GainTable->DistanceSamples, sizeof(GainTable->DistanceSamples));
+			Ar.Serialize(GainTable->AngleSamples, sizeof(GainTable->AngleSamples));
+			Cone.GainTable = GainTable;
+		}
+		else
+		{
+			FAdvancedSightGainTable GainTable = *Cone.GainTable;
+			Ar.Serialize(GainTable.DistanceSamples, sizeof(GainTable.DistanceSamples));
+			Ar.Serialize(GainTable.AngleSamples, sizeof(GainTable.AngleSamples));
+		}
+	}
+
+	for (FAdvancedSightCategoryProfile& Category : Profile.Categories)
+	{
+		Ar << Category.GainMultiplier;
+		Ar << Category.LoseSightRadius;
+		Ar << Category.LoseSightCooldown;
+	}
+
+	if (Ar.IsLoading())
+	{
+		Profile.BuildConeBatches();
+	}
+
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedListener& Listener)
+{
+	Ar << Listener.ListenerId;
+	Ar << Listener.EyeLocation;
+	Ar << Listener.EyeForward;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedTarget& Target)
+{
+	Ar << Target.TargetId;
+	Ar << Target.Location;
+	uint8 NumVisibilityPoints = static_cast<uint8>(Target.VisibilityPoints.Num());
+	Ar << NumVisibilityPoints;
+	if (Ar.IsLoading())
+	{
+		Target.VisibilityPoints.SetNum(NumVisibilityPoints);
+	}
+
+	for (FVector& VisibilityPoint : Target.VisibilityPoints)
+	{
+		Ar << VisibilityPoint;
+	}
+
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedQuery& Query)
+{
+	Ar << Query.ListenerId;
+	Ar << Query.TargetId;
+	Ar << Query.TracedPointsMask;
+	Ar << Query.ClearPointsMask;
+	Ar << Query.Illumination;
+	Ar << Query.Transmittance;
+	Ar << Query.CategoryIndex;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedQueryState& State)
+{
+	Ar << State.ListenerId;
+	Ar << State.TargetId;
+	Ar << State.GainValue;
+	Ar << State.LoseSightTimer;
+	Ar << State.bWasLastCheckSuccess;
+	Ar << State.bIsTargetPerceived;
+	Ar << State.CategoryIndex;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedQueryRemoval& Removal)
+{
+	Ar << Removal.ListenerId;
+	Ar << Removal.TargetId;
+	return Ar;
+}
+
+bool FAdvancedSightRecordedTransition::operator==(const FAdvancedSightRecordedTransition& Other) const
+{
+	return ListenerId == Other.ListenerId && TargetId == Other.TargetId && Transitions == Other.Transitions;
+}
+
+FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedTransition& Transition)
+{
+	Ar << Transition.ListenerId;
+	Ar << Transition.TargetId;
+	uint8 Transitions = static_cast<uint8>(Transition.Transitions);
+	Ar << Transitions;
+	Transition.Transitions = static_cast<EAdvancedSightTransition>(Transitions);
+	return Ar;
+}
+
+void FAdvancedSightRecordedFrame::Reset()
+{
+	DeltaTime = 0.0f;
+	InitialQueryStates.Reset();
+	RemovedListeners.Reset();
+	RemovedTargets.Reset();
+	RemovedQueries.Reset();
+	NewProfiles.Reset();
+	Listeners.Reset();
+	Targets.Reset();
+	Queries.Reset();
+	Transitions.Reset();
+}
+
+FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedFrame& Frame)
+{
+	Ar << Frame.DeltaTime;
+	Ar << Frame.InitialQueryStates;
+	Ar << Frame.RemovedListeners;
+	Ar << Frame.RemovedTargets;
+	Ar << Frame.RemovedQueries;
+	Ar << Frame.NewProfiles;
+	Ar << Frame.Listeners;
+	Ar << Frame.Targets;
+	Ar << Frame.Queries;
+	Ar << Frame.Transitions;
+	return Ar;
+}
+
+FAdvancedSightRecorder::~FAdvancedSightRecorder()
+{
+	Close();
+}
+
+bool FAdvancedSightRecorder::Open(const FString& InFilePath)
+{
+	Close();
+
+	FileWriter.Reset(IFileManager::Get().CreateFileWriter(*InFilePath));
+	if (!FileWriter.IsValid())
+	{
+		return false;
+	}
+
+	uint32 Magic = AdvancedSightRecording::Magic;
+	uint32 Version = AdvancedSightRecording::Version;
+	*FileWriter << Magic;
+	*FileWriter << Version;
+	FilePath = InFilePath;
+	NumFrames = 0;
+	return true;
+}
+
+void FAdvancedSightRecorder::Close()
+{
+	if (FileWriter.IsValid())
+	{
+		FileWriter->Close();
+		FileWriter.Reset();
+	}
+
+	RecordedProfiles.Reset();
+}
+
+bool FAdvancedSightRecorder::IsProfileRecorded(const uint32 ListenerId) const
+{
+	return RecordedProfiles.Contains(ListenerId);
+}
+
+void FAdvancedSightRecorder::WriteFrame(FAdvancedSightRecordedFrame& Frame)
+{
+	if (!ensure(FileWriter.IsValid()))
+	{
+		return;
+	}
+
+	for (const uint32 RemovedListener : Frame.RemovedListeners)
+	{
+		RecordedProfiles.Remove(RemovedListener);
+	}
+
+	for (const FAdvancedSightRecordedProfile& Profile : Frame.NewProfiles)
+	{
+		RecordedProfiles.Add(Profile.ListenerId);
+	}
+
+	FrameBuffer.Reset();
+	FMemoryWriter FrameWriter(FrameBuffer);
+	FrameWriter << Frame;
+
+	// Frames are size prefixed so a recording cut short by a crash can still be replayed up to its last full frame
+	int32 FrameSize = FrameBuffer.Num();
+	*FileWriter << FrameSize;
+	FileWriter->Serialize(FrameBuffer.GetData(), FrameBuffer.Num());
+	NumFrames++;
+}
+
+const FString& FAdvancedSightRecorder::GetFilePath() const
+{
+	return FilePath;
+}
+
+int32 FAdvancedSightRecorder::GetNumFrames() const
+{
+	return NumFrames;
+}
+
+FAdvancedSightReplayPlayer::~FAdvancedSightReplayPlayer()
+{
+	Close();
+}
+
+bool FAdvancedSightReplayPlayer::Open(const FString& FilePath)
+{
+	Close();
+
+	MappedFileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath));
+	if (!MappedFileHandle.IsValid() || MappedFileHandle->GetFileSize() < AdvancedSightRecording::HeaderSize)
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Failed to open sight recording %s"), *FilePath);
+		Close();
+		return false;
+	}
+
+	MappedFileRegion.Reset(MappedFileHandle->MapRegion(0, MappedFileHandle->GetFileSize()));
+	if (!MappedFileRegion.IsValid())
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Failed to map sight recording %s"), *FilePath);
+		Close();
+		return false;
+	}
+
+	Reader = MakeUnique<FMemoryReaderView>(
+		FMemoryView(MappedFileRegion->GetMappedPtr(), static_cast<uint64>(MappedFileRegion->GetMappedSize())));
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	*Reader << Magic;
+	*Reader << Version;
+	if (Magic != AdvancedSightRecording::Magic || Version != AdvancedSightRecording::Version)
+	{
+		UE_LOG(
+			LogAdvancedSight,
+			Error,
+			TEXT("%s is not a sight recording of version %u"),
+			*FilePath,
+			AdvancedSightRecording::Version);
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void FAdvancedSightReplayPlayer::Close()
+{
+	Reader.Reset();
+	MappedFileRegion.Reset();
+	MappedFileHandle.Reset();
+	Profiles.Reset();
+	QueryStates.Reset();
+}
+
+bool FAdvancedSightReplayPlayer::ReadNextFrame(FAdvancedSightRecordedFrame& OutFrame)
+{
+	if (!Reader.IsValid() || Reader->TotalSize() - Reader->Tell() < static_cast<int64>(sizeof(int32)))
+	{
+		return false;
+	}
+
+	int32 FrameSize = 0;
+	*Reader << FrameSize;
+	if (FrameSize < 0 || Reader->TotalSize() - Reader->Tell() < FrameSize)
+	{
+		UE_LOG(LogAdvancedSight, Warning, TEXT("Sight recording ends with a truncated frame"));
+		return false;
+	}
+
+	OutFrame.Reset();
+	*Reader << OutFrame;
+	return !Reader->IsError();
+}
+
+FAdvancedSightReplayResult FAdvancedSightReplayPlayer::Run(const bool bSingleThreaded, const bool bCollectTransitionLog)
+{
+	FAdvancedSightReplayResult Result;
+	if (!Reader.IsValid())
+	{
+		return Result;
+	}
+
+	Reader->Seek(AdvancedSightRecording::HeaderSize);
+	Profiles.Reset();
+	QueryStates.Reset();
+
+	FAdvancedSightRecordedFrame Frame;
+	TMap<uint32, const FAdvancedSightRecordedListener*> FrameListeners;
+	TMap<uint32, const FAdvancedSightRecordedTarget*> FrameTargets;
+	TArray<FAdvancedSightQuery*> FrameQueries;
+	TArray<const FAdvancedSightListenerProfile*> FrameProfiles;
+	TArray<FAdvancedSightRecordedTransition> ReplayedTransitions;
+	while (ReadNextFrame(Frame))
+	{
+		for (const FAdvancedSightRecordedQueryState& State : Frame.InitialQueryStates)
+		{
+			FAdvancedSightQuery& Query = QueryStates.Add(MakeQueryKey(State.ListenerId, State.TargetId));
+			Query.ListenerId = State.ListenerId;
+			Query.TargetId = State.TargetId;
+			Query.GainValue = State.GainValue;
+			Query.LoseSightTimer = State.LoseSightTimer;
+			Query.bWasLastCheckSuccess = State.bWasLastCheckSuccess;
+			Query.bIsTargetPerceived = State.bIsTargetPerceived;
+			Query.CategoryIndex = State.CategoryIndex;
+		}
+
+		for (const uint32 RemovedListener : Frame.RemovedListeners)
+		{
+			Profiles.Remove(RemovedListener);
+			for (auto It = QueryStates.CreateIterator(); It; ++It)
+			{
+				if (It.Value().ListenerId == RemovedListener)
+				{
+					It.RemoveCurrent();
+				}
+			}
+		}
+
+		for (const uint32 RemovedTarget : Frame.RemovedTargets)
+		{
+			for (auto It = QueryStates.CreateIterator(); It; ++It)
+			{
+				if (It.Value().TargetId == RemovedTarget)
+				{
+					It.RemoveCurrent();
+				}
+			}
+		}
+
+		for (const FAdvancedSightRecordedQueryRemoval& RemovedQuery : Frame.RemovedQueries)
+		{
+			QueryStates.Remove(MakeQueryKey(RemovedQuery.ListenerId, RemovedQuery.TargetId));
+		}
+
+		for (const FAdvancedSightRecordedProfile& Profile : Frame.NewProfiles)
+		{
+			Profiles.Add(Profile.ListenerId, Profile);
+		}
+
+		FrameListeners.Reset();
+		for (const FAdvancedSightRecordedListener& Listener : Frame.Listeners)
+		{
+			FrameListeners.Add(Listener.ListenerId, &Listener);
+		}
+
+		FrameTargets.Reset();
+		for (const FAdvancedSightRecordedTarget& Target : Frame.Targets)
+		{
+			FrameTargets.Add(Target.TargetId, &Target);
+		}
+
+		for (const FAdvancedSightRecordedQuery& RecordedQuery : Frame.Queries)
+		{
+			const uint64 QueryKey = MakeQueryKey(RecordedQuery.ListenerId, RecordedQuery.TargetId);
+			if (QueryStates.Contains(QueryKey))
+			{
+				continue;
+			}
+
+			const FAdvancedSightRecordedProfile* Profile = Profiles.Find(RecordedQuery.ListenerId);
+			if (!ensureMsgf(Profile, TEXT("Sight recording is missing the profile of listener %u"), RecordedQuery.ListenerId))
+			{
+				continue;
+			}
+
+			FAdvancedSightQuery& Query = QueryStates.Add(QueryKey);
+			Query.ListenerId = RecordedQuery.ListenerId;
+			Query.TargetId = RecordedQuery.TargetId;
+		}
+
+		FrameQueries.Reset();
+		FrameProfiles.Reset();
+		for (const FAdvancedSightRecordedQuery& RecordedQuery : Frame.Queries)
+		{
+			FAdvancedSightQuery* Query = QueryStates.Find(MakeQueryKey(RecordedQuery.ListenerId, RecordedQuery.TargetId));
+			const FAdvancedSightListenerProfile* Profile = Profiles.Find(RecordedQuery.ListenerId);
+			// Initial query states are restored for every listener, while profiles are only recorded once a listener
+			// is evaluated, e.g. not for one that was dormant when the recording started
+			ensureMsgf(!Query || Profile,
+				TEXT("Sight recording is missing the profile of listener %u"), RecordedQuery.ListenerId);
+			FrameQueries.Add(Query);
+			FrameProfiles.Add(Profile);
+		}
+
+		const double VisibilityStartTime = FPlatformTime::Seconds();
+		ParallelFor(FrameQueries.Num(), [&Frame, &FrameQueries, &FrameProfiles, &FrameListeners, &FrameTargets](int32 Index)
+		{
+			FAdvancedSightQuery* Query = FrameQueries[Index];
+			const FAdvancedSightRecordedListener* Listener = FrameListeners.FindRef(Frame.Queries[Index].ListenerId);
+			const FAdvancedSightRecordedTarget* Target = FrameTargets.FindRef(Frame.Queries[Index].TargetId);
+			if (!Query || !FrameProfiles[Index] || !Listener || !Target)
+			{
+				return;
+			}
+
+			Query->CategoryIndex = Frame.Queries[Index].CategoryIndex;
+			const uint32 ClearPointsMask = Frame.Queries[Index].ClearPointsMask;
+			const float Illumination = FAdvancedSightIllumination::Dequantize(Frame.Queries[Index].Illumination);
+			const float Transmittance = FAdvancedSightTransmittanceTable::Dequantize(Frame.Queries[Index].Transmittance);
+			UAdvancedSightSystem::EvaluateQueryVisibility(
+				*Query,
+				*FrameProfiles[Index],
+				Listener->EyeLocation,
+				Listener->EyeForward,
+				Target->VisibilityPoints,
+				[ClearPointsMask, Transmittance](int32 PointIndex)
+				{
+					return ((ClearPointsMask >> PointIndex) & 1) != 0 ? Transmittance : 0.0f;
+				},
+				[Illumination](int32 PointIndex)
+				{
+					return Illumination;
+				});
+		},
+		bSingleThreaded);
+		Result.VisibilitySeconds += FPlatformTime::Seconds() - VisibilityStartTime;
+
+		const double StateStartTime = FPlatformTime::Seconds();
+		ReplayedTransitions.Reset();
+		for (int32 Index = 0; Index < FrameQueries.Num(); Index++)
+		{
+			FAdvancedSightQuery* Query = FrameQueries[Index];
+			const FAdvancedSightRecordedTarget* Target = FrameTargets.FindRef(Frame.Queries[Index].TargetId);
+			if (!Query || !FrameProfiles[Index] || !Target)
+			{
+				continue;
+			}
+
+			const EAdvancedSightTransition Transitions =
+				UAdvancedSightSystem::UpdateQueryState(*Query, *FrameProfiles[Index], Frame.DeltaTime);
+			if (Transitions != EAdvancedSightTransition::None)
+			{
+				ReplayedTransitions.Add({ Query->ListenerId, Query->TargetId, Transitions });
+			}
+		}
+		Result.StateSeconds += FPlatformTime::Seconds() - StateStartTime;
+
+		if (ReplayedTransitions != Frame.Transitions)
+		{
+			if (Result.FirstMismatchedFrame == INDEX_NONE)
+			{
+				Result.FirstMismatchedFrame = Result.NumFrames;
+			}
+
+			Result.NumMismatchedFrames++;
+		}
+
+		if (bCollectTransitionLog)
+		{
+			for (const FAdvancedSightRecordedTransition& Transition : ReplayedTransitions)
+			{
+				Result.TransitionLog.Add(FString::Printf(
+					TEXT("%d %u %u %u"),
+					Result.NumFrames,
+					Transition.ListenerId,
+					Transition.TargetId,
+					static_cast<uint32>(Transition.Transitions)));
+			}
+		}
+
+		Result.NumTransitions += ReplayedTransitions.Num();
+		Result.NumQueryEvaluations += FrameQueries.Num();
+		Result.NumFrames++;
+	}
+
+	return Result;
+}
+
+uint64 FAdvancedSightReplayPlayer::MakeQueryKey(const uint32 ListenerId, const uint32 TargetId)
+{
+	return (static_cast<uint64>(ListenerId) << 32) | TargetId;
+}
@@ -0,0 +1,82 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightReplayCommandlet.h"
+
+#include "AdvancedSightCommon.h"
+#include "AdvancedSightRecording.h"
+#include "Misc/FileHelper.h"
+
+UAdvancedSightReplayCommandlet::UAdvancedSightReplayCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UAdvancedSightReplayCommandlet::Main(const FString& Params)
+{
+	FString FilePath;
+	if (!FParse::Value(*Params, TEXT("File="), FilePath))
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Missing -File=<recording> argument"));
+		return 1;
+	}
+
+	int32 NumIterations = 1;
+	FParse::Value(*Params, TEXT("Iterations="), NumIterations);
+	NumIterations = FMath::Max(NumIterations, 1);
+	const bool bSingleThreaded = FParse::Param(*Params, TEXT("SingleThreaded"));
+	FString TransitionsOutputPath;
+	const bool bWriteTransitions = FParse::Value(*Params, TEXT("TransitionsOutput="), TransitionsOutputPath);
+
+	FAdvancedSightReplayPlayer ReplayPlayer;
+	if (!ReplayPlayer.Open(FilePath))
+	{
+		return 1;
+	}
+
+	double MinVisibilitySeconds = MAX_dbl;
+	double MinStateSeconds = MAX_dbl;
+	FAdvancedSightReplayResult Result;
+	for (int32 Iteration = 0; Iteration < NumIterations; Iteration++)
+	{
+		const bool bIsLastIteration = Iteration == NumIterations - 1;
+		Result = ReplayPlayer.Run(bSingleThreaded, bWriteTransitions && bIsLastIteration);
+		MinVisibilitySeconds = FMath::Min(MinVisibilitySeconds, Result.VisibilitySeconds);
+		MinStateSeconds = FMath::Min(MinStateSeconds, Result.StateSeconds);
+	}
+
+	UE_LOG(
+		LogAdvancedSight,
+		Display,
+		TEXT("Replayed %d frames, %lld query evaluations, %d transitions"),
+		Result.NumFrames,
+		Result.NumQueryEvaluations,
+		Result.NumTransitions);
+	UE_LOG(
+		LogAdvancedSight,
+		Display,
+		TEXT("Best of %d: visibility %.3f ms, state %.3f ms"),
+		NumIterations,
+		MinVisibilitySeconds * 1000.0,
+		MinStateSeconds * 1000.0);
+
+	if (bWriteTransitions && !FFileHelper::SaveStringArrayToFile(Result.TransitionLog, *TransitionsOutputPath))
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Failed to write transitions to %s"), *TransitionsOutputPath);
+	}
+
+	if (Result.NumMismatchedFrames > 0)
+	{
+		UE_LOG(
+			LogAdvancedSight,
+			Error,
+			TEXT("Replayed transitions differ from the recording in %d frames, first at frame %d"),
+			Result.NumMismatchedFrames,
+			Result.FirstMismatchedFrame);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightReplication.h"
+
+#include "AdvancedSightReplicationComponent.h"
+
+void FAdvancedSightReplicatedTarget::PreReplicatedRemove(const FAdvancedSightReplicatedTargets& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->ApplyReplicatedTarget(*this, true);
+	}
+}
+
+void FAdvancedSightReplicatedTarget::PostReplicatedAdd(const FAdvancedSightReplicatedTargets& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->ApplyReplicatedTarget(*this, false);
+	}
+}
+
+void FAdvancedSightReplicatedTarget::PostReplicatedChange(const FAdvancedSightReplicatedTargets& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->ApplyReplicatedTarget(*this, false);
+	}
+}
+
+uint8 FAdvancedSightReplicatedTarget::QuantizeGain(const float GainValue)
+{
+	return static_cast<uint8>(FMath::RoundToInt(FMath::Clamp(GainValue, 0.0f, 1.0f) * MAX_uint8));
+}
+
+float FAdvancedSightReplicatedTarget::DequantizeGain(const uint8 QuantizedGain)
+{
+	return QuantizedGain / static_cast<float>(MAX_uint8);
+}
+
+FAdvancedSightReplicatedTarget* FAdvancedSightReplicatedTargets::FindItem(const AActor* TargetActor)
+{
+	return Items.FindByPredicate([TargetActor](const FAdvancedSightReplicatedTarget& Item)
+	{
+		return Item.TargetActor == TargetActor;
+	});
+}
+
+const FAdvancedSightReplicatedTarget* FAdvancedSightReplicatedTargets::FindItem(const AActor* TargetActor) const
+{
+	return const_cast<FAdvancedSightReplicatedTargets*>(this)->FindItem(TargetActor);
+}
+
+bool FAdvancedSightReplicatedTargets::SetItem(
+	AActor* TargetActor, const EAdvancedSightTargetState State, const uint8 QuantizedGain)
+{
+	if (State == EAdvancedSightTargetState::None && QuantizedGain == 0)
+	{
+		return RemoveItem(TargetActor);
+	}
+
+	FAdvancedSightReplicatedTarget* Item = FindItem(TargetActor);
+	if (!Item)
+	{
+		Item = &Items.AddDefaulted_GetRef();
+		Item->TargetActor = TargetActor;
+	}
+	else if (Item->State == State && Item->QuantizedGain == QuantizedGain)
+	{
+		return false;
+	}
+
+	Item->State = State;
+	Item->QuantizedGain = QuantizedGain;
+	MarkItemDirty(*Item);
+	return true;
+}
+
+bool FAdvancedSightReplicatedTargets::RemoveItem(const AActor* TargetActor)
+{
+	const int32 ItemIndex = Items.IndexOfByPredicate([TargetActor](const FAdvancedSightReplicatedTarget& Item)
+	{
+		return Item.TargetActor == TargetActor;
+	});
+
+	if (ItemIndex != INDEX_NONE)
+	{
+		Items.RemoveAtSwap(ItemIndex);
+		MarkArrayDirty();
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,163 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightReplicationComponent.h"
+
+#include "Net/UnrealNetwork.h"
+#include "Net/Core/PushModel/PushModel.h"
+
+UAdvancedSightReplicationComponent::UAdvancedSightReplicationComponent()
+	: ReplicatedTargets(this)
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+}
+
+void UAdvancedSightReplicationComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	FDoRepLifetimeParams Params;
+	Params.bIsPushBased = true;
+	DOREPLIFETIME_WITH_PARAMS_FAST(UAdvancedSightReplicationComponent, ReplicatedTargets, Params);
+}
+
+void UAdvancedSightReplicationComponent::SetTargetState(AActor* TargetActor, const EAdvancedSightTargetState State)
+{
+	const FAdvancedSightReplicatedTarget* Item = ReplicatedTargets.FindItem(TargetActor);
+	SetTarget(TargetActor, State, Item ? Item->QuantizedGain : 0);
+}
+
+void UAdvancedSightReplicationComponent::SetQuantizedGain(AActor* TargetActor, const uint8 QuantizedGain)
+{
+	const FAdvancedSightReplicatedTarget* Item = ReplicatedTargets.FindItem(TargetActor);
+	SetTarget(TargetActor, Item ? Item->State : EAdvancedSightTargetState::None, QuantizedGain);
+}
+
+void UAdvancedSightReplicationComponent::SetTarget(
+	AActor* TargetActor, const EAdvancedSightTargetState State, const uint8 QuantizedGain)
+{
+	if (ReplicatedTargets.SetItem(TargetActor, State, QuantizedGain))
+	{
+		MARK_PROPERTY_DIRTY_FROM_NAME(UAdvancedSightReplicationComponent, ReplicatedTargets, this);
+	}
+}
+
+void UAdvancedSightReplicationComponent::ResetTargets()
+{
+	if (!ReplicatedTargets.Items.IsEmpty())
+	{
+		ReplicatedTargets.Items.Reset();
+		ReplicatedTargets.MarkArrayDirty();
+		MARK_PROPERTY_DIRTY_FROM_NAME(UAdvancedSightReplicationComponent, ReplicatedTargets, this);
+	}
+}
+
+float UAdvancedSightReplicationComponent::GetGainValueForTarget(const AActor* TargetActor) const
+{
+	const FAdvancedSightReplicatedTarget* Item = ReplicatedTargets.FindItem(TargetActor);
+	return Item ? FAdvancedSightReplicatedTarget::DequantizeGain(Item->QuantizedGain) : 0.0f;
+}
+
+EAdvancedSightTargetState UAdvancedSightReplicationComponent::GetTargetState(const AActor* TargetActor) const
+{
+	const FAdvancedSightReplicatedTarget* Item = ReplicatedTargets.FindItem(TargetActor);
+	return Item ? Item->State : EAdvancedSightTargetState::None;
+}
+
+const TArray<AActor*>& UAdvancedSightReplicationComponent::GetPerceivedTargets() const
+{
+	return PerceivedTargets;
+}
+
+const TArray<AActor*>& UAdvancedSightReplicationComponent::GetSpottedTargets() const
+{
+	return SpottedTargets;
+}
+
+const TArray<AActor*>& UAdvancedSightReplicationComponent::GetRememberedTargets() const
+{
+	return RememberedTargets;
+}
+
+void UAdvancedSightReplicationComponent::ApplyReplicatedTarget(
+	FAdvancedSightReplicatedTarget& Item, const bool bIsRemoved)
+{
+	AActor* TargetActor = Item.TargetActor;
+	if (Item.AppliedTargetActor.Get() != TargetActor)
+	{
+		// Either the target was not relevant to this client before or the item got reused for another one
+		if (AActor* PreviousTargetActor = Item.AppliedTargetActor.Get())
+		{
+			ApplyTargetState(PreviousTargetActor, Item.AppliedState, EAdvancedSightTargetState::None);
+		}
+		Item.AppliedState = EAdvancedSightTargetState::None;
+		Item.AppliedQuantizedGain = 0;
+	}
+
+	Item.AppliedTargetActor = TargetActor;
+	if (!TargetActor)
+	{
+		return;
+	}
+
+	const EAdvancedSightTargetState NewState = bIsRemoved ? EAdvancedSightTargetState::None : Item.State;
+	ApplyTargetState(TargetActor, Item.AppliedState, NewState);
+	Item.AppliedState = NewState;
+
+	const uint8 NewQuantizedGain = bIsRemoved ? 0 : Item.QuantizedGain;
+	if (NewQuantizedGain != Item.AppliedQuantizedGain)
+	{
+		Item.AppliedQuantizedGain = NewQuantizedGain;
+		OnTargetGainChanged.Broadcast(TargetActor, FAdvancedSightReplicatedTarget::DequantizeGain(NewQuantizedGain));
+	}
+}
+
+void UAdvancedSightReplicationComponent::ApplyTargetState(
+	AActor* TargetActor, const EAdvancedSightTargetState OldState, const EAdvancedSightTargetState NewState)
+{
+	const EAdvancedSightTargetState AddedState = NewState & ~OldState;
+	const EAdvancedSightTargetState RemovedState = OldState & ~NewState;
+	auto SyncTargets = [TargetActor, AddedState, RemovedState](
+		TArray<TObjectPtr<AActor>>& Targets, const EAdvancedSightTargetState State)
+	{
+		if (EnumHasAnyFlags(AddedState, State))
+		{
+			Targets.AddUnique(TargetActor);
+		}
+		else if (EnumHasAnyFlags(RemovedState, State))
+		{
+			Targets.RemoveSwap(TargetActor);
+		}
+	};
+	SyncTargets(SpottedTargets, EAdvancedSightTargetState::Spotted);
+	SyncTargets(PerceivedTargets, EAdvancedSightTargetState::Perceived);
+	SyncTargets(RememberedTargets, EAdvancedSightTargetState::Remembered);
+
+	// Several transitions between two replication updates arrive as one change, so the delegates follow the same
+	// order the authority dispatches them in
+	if (EnumHasAnyFlags(AddedState, EAdvancedSightTargetState::Spotted))
+	{
+		OnTargetSpotted.Broadcast(TargetActor);
+		OnTargetTransition.Broadcast(TargetActor, EAdvancedSightTransition::Spotted);
+	}
+
+	if (EnumHasAnyFlags(AddedState, EAdvancedSightTargetState::Perceived))
+	{
+		OnTargetPerceived.Broadcast(TargetActor);
+		OnTargetTransition.Broadcast(TargetActor, EAdvancedSightTransition::Perceived);
+	}
+
+	if (EnumHasAnyFlags(RemovedState, EAdvancedSightTargetState::Perceived)
+		|| (EnumHasAnyFlags(RemovedState, EAdvancedSightTargetState::Spotted)
+			&& !EnumHasAnyFlags(AddedState, EAdvancedSightTargetState::Perceived)))
+	{
+		OnTargetLost.Broadcast(TargetActor);
+		OnTargetTransition.Broadcast(TargetActor, EAdvancedSightTransition::Lost);
+	}
+
+	if (EnumHasAnyFlags(RemovedState, EAdvancedSightTargetState::Remembered))
+	{
+		OnTargetForgot.Broadcast(TargetActor);
+		OnTargetTransition.Broadcast(TargetActor, EAdvancedSightTransition::Forgot);
+	}
+}
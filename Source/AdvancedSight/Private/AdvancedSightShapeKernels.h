@@ -0,0 +1,125 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSightQuery.h"
+
+// Visibility point relative to the listener eyes, X forward, Y right and Z up
+struct FAdvancedSightEyeSpacePoint
+{
+	FVector Location = FVector::ZeroVector;
+	float DistanceSq = 0.0f;
+};
+
+// Shape tests are combined with non short-circuit operators so the inner loops have no branches
+template<EAdvancedSightConeShape Shape>
+struct TAdvancedSightShapeKernel;
+
+template<>
+struct TAdvancedSightShapeKernel<EAdvancedSightConeShape::Cone>
+{
+	static FORCEINLINE bool IsInside(
+		const FAdvancedSightCone& Cone, const FAdvancedSightEyeSpacePoint& Point, const float Radius, const float RadiusSq)
+	{
+		return (Point.DistanceSq <= RadiusSq) & (Point.Location.X >= Cone.CosHalfFOV * FMath::Sqrt(Point.DistanceSq));
+	}
+};
+
+template<>
+struct TAdvancedSightShapeKernel<EAdvancedSightConeShape::Frustum>
+{
+	static FORCEINLINE bool IsInside(
+		const FAdvancedSightCone& Cone, const FAdvancedSightEyeSpacePoint& Point, const float Radius, const float RadiusSq)
+	{
+		const FVector& Location = Point.Location;
+		return (Point.DistanceSq <= RadiusSq)
+			& (Location.X > 0.0f)
+			& (FMath::Abs(Location.Y) <= Cone.TanHalfFOV * Location.X)
+			& (FMath::Abs(Location.Z) <= Cone.TanHalfVerticalFOV * Location.X);
+	}
+};
+
+template<>
+struct TAdvancedSightShapeKernel<EAdvancedSightConeShape::Ellipse>
+{
+	static FORCEINLINE bool IsInside(
+		const FAdvancedSightCone& Cone, const FAdvancedSightEyeSpacePoint& Point, const float Radius, const float RadiusSq)
+	{
+		// (Y / (TanH * X))^2 + (Z / (TanV * X))^2 <= 1 without the divisions
+		const FVector& Location = Point.Location;
+		const float TanH = Cone.TanHalfFOV;
+		const float TanV = Cone.TanHalfVerticalFOV;
+		return (Point.DistanceSq <= RadiusSq)
+			& (Location.X > 0.0f)
+			& (FMath::Square(Location.Y * TanV) + FMath::Square(Location.Z * TanH) <= FMath::Square(TanH * TanV * Location.X));
+	}
+};
+
+template<>
+struct TAdvancedSightShapeKernel<EAdvancedSightConeShape::Box>
+{
+	static FORCEINLINE bool IsInside(
+		const FAdvancedSightCone& Cone, const FAdvancedSightEyeSpacePoint& Point, const float Radius, const float RadiusSq)
+	{
+		const FVector& Location = Point.Location;
+		return (Location.X >= 0.0f)
+			& (Location.X <= Radius)
+			& (FMath::Abs(Location.Y) <= Cone.BoxHalfSize.X)
+			& (FMath::Abs(Location.Z) <= Cone.BoxHalfSize.Y);
+	}
+};
+
+namespace AdvancedSightShapeKernels
+{
+	template<EAdvancedSightConeShape Shape>
+	void GatherPointsInsideBatch(
+		const FAdvancedSightListenerProfile& Profile,
+		const FAdvancedSightConeBatch& Batch,
+		TConstArrayView<FAdvancedSightEyeSpacePoint> Points,
+		const float RadiusBias,
+		uint32* OutConePointMasks)
+	{
+		for (int32 Index = Batch.FirstIndex; Index < Batch.FirstIndex + Batch.NumCones; Index++)
+		{
+			const int32 ConeIndex = Profile.ConeIndicesByShape[Index];
+			const FAdvancedSightCone& Cone = Profile.Cones[ConeIndex];
+			const float Radius = Cone.GainRadius + RadiusBias;
+			const float RadiusSq = FMath::Square(Radius);
+			uint32 PointsMask = 0;
+			for (int32 PointIndex = 0; PointIndex < Points.Num(); PointIndex++)
+			{
+				const bool bIsInside = TAdvancedSightShapeKernel<Shape>::IsInside(Cone, Points[PointIndex], Radius, RadiusSq);
+				PointsMask |= static_cast<uint32>(bIsInside) << PointIndex;
+			}
+			OutConePointMasks[ConeIndex] = PointsMask;
+		}
+	}
+
+	// Writes the mask of points inside of every profile cone, indexed like the profile cones
+	inline void GatherPointsInsideCones(
+		const FAdvancedSightListenerProfile& Profile,
+		TConstArrayView<FAdvancedSightEyeSpacePoint> Points,
+		const float RadiusBias,
+		uint32* OutConePointMasks)
+	{
+		for (const FAdvancedSightConeBatch& Batch : Profile.ConeBatches)
+		{
+			switch (Batch.Shape)
+			{
+			case EAdvancedSightConeShape::Cone:
+				GatherPointsInsideBatch<EAdvancedSightConeShape::Cone>(Profile, Batch, Points, RadiusBias, OutConePointMasks);
+				break;
+			case EAdvancedSightConeShape::Frustum:
+				GatherPointsInsideBatch<EAdvancedSightConeShape::Frustum>(Profile, Batch, Points, RadiusBias, OutConePointMasks);
+				break;
+			case EAdvancedSightConeShape::Ellipse:
+				GatherPointsInsideBatch<EAdvancedSightConeShape::Ellipse>(Profile, Batch, Points, RadiusBias, OutConePointMasks);
+				break;
+			case EAdvancedSightConeShape::Box:
+				GatherPointsInsideBatch<EAdvancedSightConeShape::Box>(Profile, Batch, Points, RadiusBias, OutConePointMasks);
+				break;
+			}
+		}
+	}
+}
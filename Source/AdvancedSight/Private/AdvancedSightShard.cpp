@@ -0,0 +1,110 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightShard.h"
+
+bool FAdvancedSightShard::IsEmpty() const
+{
+	return TargetIds.IsEmpty() && ListenerIndices.IsEmpty();
+}
+
+void FAdvancedSightShard::Reset()
+{
+	TargetIds.Reset();
+	ListenerIndices.Reset();
+	QueryIndices.Reset();
+	QueryListenerIndices.Reset();
+	CandidateTargetIds.Reset();
+}
+
+void FAdvancedSightShardGrid::Reset(const float InCellSize)
+{
+	// Shards are kept so the ones that stay occupied reuse their allocations
+	if (CellSize != InCellSize)
+	{
+		Shards.Reset();
+		CellSize = InCellSize;
+	}
+
+	for (TTuple<FIntPoint, FAdvancedSightShard>& Shard : Shards)
+	{
+		Shard.Value.Reset();
+	}
+	ShardList.Reset();
+}
+
+FIntPoint FAdvancedSightShardGrid::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+void FAdvancedSightShardGrid::GetCellRange(
+	const FVector& Location, const float Radius, FIntPoint& OutMinCell, FIntPoint& OutMaxCell) const
+{
+	OutMinCell = GetCell(Location - FVector(Radius));
+	OutMaxCell = GetCell(Location + FVector(Radius));
+}
+
+bool FAdvancedSightShardGrid::IsCellInRange(const FIntPoint& Cell, const FIntPoint& MinCell, const FIntPoint& MaxCell)
+{
+	return Cell.X >= MinCell.X && Cell.X <= MaxCell.X && Cell.Y >= MinCell.Y && Cell.Y <= MaxCell.Y;
+}
+
+void FAdvancedSightShardGrid::AddTarget(const FIntPoint& Cell, const uint32 TargetId)
+{
+	Shards.FindOrAdd(Cell).TargetIds.Add(TargetId);
+}
+
+void FAdvancedSightShardGrid::AddListener(const FIntPoint& Cell, const int32 ListenerIndex)
+{
+	Shards.FindOrAdd(Cell).ListenerIndices.Add(ListenerIndex);
+}
+
+void FAdvancedSightShardGrid::FinishBuild()
+{
+	ShardList.Reset();
+	for (auto It = Shards.CreateIterator(); It; ++It)
+	{
+		if (It.Value().IsEmpty())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	for (TTuple<FIntPoint, FAdvancedSightShard>& Shard : Shards)
+	{
+		ShardList.Add(&Shard.Value);
+	}
+}
+
+void FAdvancedSightShardGrid::GatherTargetIds(
+	const FVector& Location, const float Radius, TArray<uint32>& OutTargetIds) const
+{
+	FIntPoint MinCell;
+	FIntPoint MaxCell;
+	GetCellRange(Location, Radius, MinCell, MaxCell);
+	for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+	{
+		for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+		{
+			if (const FAdvancedSightShard* Shard = Shards.Find(FIntPoint(X, Y)))
+			{
+				OutTargetIds.Append(Shard->TargetIds);
+			}
+		}
+	}
+}
+
+int32 FAdvancedSightShardGrid::Num() const
+{
+	return ShardList.Num();
+}
+
+FAdvancedSightShard& FAdvancedSightShardGrid::GetShard(const int32 Index)
+{
+	return *ShardList[Index];
+}
+
+const FAdvancedSightShard& FAdvancedSightShardGrid::GetShard(const int32 Index) const
+{
+	return *ShardList[Index];
+}
@@ -0,0 +1,52 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightSnapshot.h"
+
+FArchive& operator<<(FArchive& Ar, FAdvancedSightPersistentQuery& Query)
+{
+	Ar << Query.ListenerIndex;
+	Ar << Query.TargetIndex;
+	Ar << Query.Flags;
+	Ar << Query.GainValue;
+	Ar << Query.LoseSightTimer;
+	Ar << Query.LastSeenLocation;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FAdvancedSightPersistentListener& Listener)
+{
+	Ar << Listener.ListenerIndex;
+	Ar << Listener.PerceivedTargets;
+	Ar << Listener.SpottedTargets;
+	Ar << Listener.RememberedTargets;
+	return Ar;
+}
+
+bool FAdvancedSightPerceptionSnapshot::IsEmpty() const
+{
+	return Queries.IsEmpty() && Listeners.IsEmpty();
+}
+
+void FAdvancedSightPerceptionSnapshot::Reset()
+{
+	Ids.Reset();
+	Queries.Reset();
+	Listeners.Reset();
+}
+
+bool FAdvancedSightPerceptionSnapshot::Serialize(FArchive& Ar)
+{
+	uint32 SerializedMagic = Magic;
+	uint32 SerializedVersion = Version;
+	Ar << SerializedMagic;
+	Ar << SerializedVersion;
+	if (SerializedMagic != Magic || SerializedVersion != Version)
+	{
+		return false;
+	}
+
+	Ar << Ids;
+	Ar << Queries;
+	Ar << Listeners;
+	return !Ar.IsError();
+}
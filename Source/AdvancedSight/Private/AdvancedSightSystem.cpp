@@ -2,321 +2,2142 @@
 
 #include "AdvancedSightSystem.h"
 
+#include "AdvancedSenseHearing.h"
+#include "AdvancedSenseProximity.h"
+#include "AdvancedSightCommon.h"
 #include "AdvancedSightComponent.h"
 #include "AdvancedSightData.h"
+#include "AdvancedSightIlluminationGrid.h"
+#include "AdvancedSightLightComponent.h"
+#include "AdvancedSightOccluderComponent.h"
 #include "AdvancedSightSettings.h"
+#include "AdvancedSightShapeKernels.h"
 #include "AdvancedSightTarget.h"
 #include "AdvancedSightTargetComponent.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Sort.h"
+#include "Engine/Level.h"
 #include "Kismet/GameplayStatics.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
 
 static TAutoConsoleVariable<bool> CVarShouldDebugDraw(
 	TEXT("AdvancedSight.ShouldDebugDraw"), false, TEXT("Set this to true to see the closest listener debug drawing"));
 
+static TAutoConsoleVariable<bool> CVarUseVisibilitySets(
+	TEXT("AdvancedSight.UseVisibilitySets"),
+	true,
+	TEXT("Set this to false to trace every pair, even the ones the baked visibility sets reject"));
+
+static FAutoConsoleCommandWithWorldAndArgs CmdStartRecording(
+	TEXT("AdvancedSight.StartRecording"),
+	TEXT("Starts recording sight inputs of the current world. Optional argument: output file path"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		auto* SightSystem = World ? World->GetSubsystem<UAdvancedSightSystem>() : nullptr;
+		if (!SightSystem)
+		{
+			return;
+		}
+
+		const FString FilePath = Args.Num() > 0
+			? Args[0]
+			: FPaths::ProfilingDir() / TEXT("AdvancedSight") / FDateTime::Now().ToString() + TEXT(".asrec");
+		SightSystem->StartRecording(FilePath);
+	}));
+
+static FAutoConsoleCommandWithWorld CmdStopRecording(
+	TEXT("AdvancedSight.StopRecording"),
+	TEXT("Stops recording sight inputs of the current world"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (auto* SightSystem = World ? World->GetSubsystem<UAdvancedSightSystem>() : nullptr)
+		{
+			SightSystem->StopRecording();
+		}
+	}));
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Listeners"), STAT_AdvancedSight_Listeners, STATGROUP_AdvancedSight);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dormant listeners"), STAT_AdvancedSight_DormantListeners, STATGROUP_AdvancedSight);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries"), STAT_AdvancedSight_Queries, STATGROUP_AdvancedSight);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Active queries"), STAT_AdvancedSight_ActiveQueries, STATGROUP_AdvancedSight);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shards"), STAT_AdvancedSight_Shards, STATGROUP_AdvancedSight);
+
+// Covers the offset of the eyes and visibility points from the actor locations the shards are built from
+static constexpr float BroadphaseMargin = 500.0f;
+
 void UAdvancedSightSystem::RegisterListener(UAdvancedSightComponent* SightComponent)
 {
 	Listeners.Add(SightComponent->GetUniqueID(), SightComponent);
+	FAdvancedSightListenerQueries& ListenerEntry = ListenerQueries.Add(SightComponent->GetUniqueID());
+	ListenerEntry.StaggerSlot = NextStaggerSlot++;
+	bShouldApplyPendingSnapshot = !PendingSnapshot.IsEmpty();
+	if (UAdvancedSightData* SightData = SightComponent->GetSightData())
+	{
+		SightData->ConditionalBakeCones();
+		ListenerEntry.Profile.SetCones(SightData->GetCones());
+		ListenerEntry.Profile.LoseSightRadius = SightData->LoseSightRadius;
+		ListenerEntry.Profile.LoseSightCooldown = SightData->LoseSightCooldown;
+		ListenerEntry.Profile.HearingRadius = SightData->HearingRadius;
+		ListenerEntry.Profile.ProximityRadius = SightData->ProximityRadius;
+		ListenerEntry.Profile.DarknessGainMultiplier = SightData->DarknessGainMultiplier;
+		ListenerEntry.Profile.SetCategoryTuning(SightData->CategoryTuning);
+		ListenerEntry.Profile.BroadphaseRadius = SightData->LoseSightRadius;
+		for (const FAdvancedSightCone& Cone : ListenerEntry.Profile.Cones)
+		{
+			ListenerEntry.Profile.BroadphaseRadius = FMath::Max(ListenerEntry.Profile.BroadphaseRadius, Cone.GetReach());
+		}
+
+		for (const FAdvancedSightCategoryProfile& Category : ListenerEntry.Profile.Categories)
+		{
+			ListenerEntry.Profile.BroadphaseRadius =
+				FMath::Max(ListenerEntry.Profile.BroadphaseRadius, Category.LoseSightRadius);
+		}
+	}
+
 	for (const TTuple<unsigned, TWeakObjectPtr<AActor>>& TargetActor : TargetActors)
 	{
-		AddQuery(SightComponent, TargetActor.Value.Get(), SightComponent->GetSightData());
+		AddQuery(SightComponent, TargetActor.Value.Get(), SightComponent->GetSightData());
+	}
+}
+
+void UAdvancedSightSystem::UnregisterListener(UAdvancedSightComponent* SightComponent)
+{
+	Listeners.Remove(SightComponent->GetUniqueID());
+	ListenerQueries.Remove(SightComponent->GetUniqueID());
+	DormantListeners.Remove(SightComponent->GetUniqueID());
+	if (Recorder.IsValid())
+	{
+		RecordedFrame.RemovedListeners.Add(SightComponent->GetUniqueID());
+	}
+
+	for (const TSharedRef<FAdvancedSenseBase>& Sense : Senses)
+	{
+		Sense->OnListenerRemoved(SightComponent->GetUniqueID());
+	}
+
+	TombstoneQueries([SightComponent](const FAdvancedSightQuery& Query)
+	{
+		return SightComponent->GetUniqueID() == Query.ListenerId;
+	});
+}
+
+void UAdvancedSightSystem::RegisterTarget(AActor* TargetActor)
+{
+	if (!TargetActor->Implements<UAdvancedSightTarget>())
+	{
+		return;
+	}
+
+	TargetActors.Add(TargetActor->GetUniqueID(), TargetActor);
+	TargetCategories.Add(TargetActor->GetUniqueID(), GetTargetCategories(TargetActor));
+	bShouldApplyPendingSnapshot = !PendingSnapshot.IsEmpty();
+	for (const TTuple<unsigned, TWeakObjectPtr<UAdvancedSightComponent>>& Listener : Listeners)
+	{
+		AddQuery(Listener.Value.Get(), TargetActor, Listener.Value->GetSightData());
+	}
+}
+
+void UAdvancedSightSystem::UnregisterTarget(AActor* TargetActor)
+{
+	TargetActors.Remove(TargetActor->GetUniqueID());
+	TargetCategories.Remove(TargetActor->GetUniqueID());
+	if (Recorder.IsValid())
+	{
+		RecordedFrame.RemovedTargets.Add(TargetActor->GetUniqueID());
+	}
+
+	for (const TSharedRef<FAdvancedSenseBase>& Sense : Senses)
+	{
+		Sense->OnTargetRemoved(TargetActor->GetUniqueID());
+	}
+
+	TombstoneQueries([TargetActor](const FAdvancedSightQuery& Query)
+	{
+		return TargetActor->GetUniqueID() == Query.TargetId;
+	});
+}
+
+void UAdvancedSightSystem::UpdateListenerCategories(const UAdvancedSightComponent* SightComponent)
+{
+	PendingCategoryListeners.Add(SightComponent);
+}
+
+void UAdvancedSightSystem::UpdateTargetCategories(const AActor* TargetActor)
+{
+	PendingCategoryTargets.Add(TargetActor);
+}
+
+void UAdvancedSightSystem::ApplyPendingCategoryChanges()
+{
+	// Perception delegates fired while applying may change categories again, those changes wait for the next update
+	const TSet<TWeakObjectPtr<const UAdvancedSightComponent>> CategoryListeners = MoveTemp(PendingCategoryListeners);
+	const TSet<TWeakObjectPtr<const AActor>> CategoryTargets = MoveTemp(PendingCategoryTargets);
+	PendingCategoryListeners.Reset();
+	PendingCategoryTargets.Reset();
+
+	for (const TWeakObjectPtr<const UAdvancedSightComponent>& SightComponent : CategoryListeners)
+	{
+		if (SightComponent.IsValid() && Listeners.Contains(SightComponent->GetUniqueID()))
+		{
+			ApplyListenerCategories(SightComponent.Get());
+		}
+	}
+
+	for (const TWeakObjectPtr<const AActor>& TargetActor : CategoryTargets)
+	{
+		if (TargetActor.IsValid())
+		{
+			ApplyTargetCategories(TargetActor.Get());
+		}
+	}
+}
+
+void UAdvancedSightSystem::ApplyListenerCategories(const UAdvancedSightComponent* SightComponent)
+{
+	const uint32 ListenerId = SightComponent->GetUniqueID();
+	const uint8 SubscribedCategories = SightComponent->GetSubscribedCategories();
+	RemoveUnsubscribedQueries([this, ListenerId, SubscribedCategories](const FAdvancedSightQuery& Query)
+	{
+		return Query.ListenerId == ListenerId && (TargetCategories.FindRef(Query.TargetId) & SubscribedCategories) == 0;
+	});
+
+	TSet<uint32> QueriedTargets;
+	for (FAdvancedSightQuery& Query : Queries)
+	{
+		if (Query.ListenerId == ListenerId && !Query.bIsRemoved)
+		{
+			const uint8 Categories = TargetCategories.FindRef(Query.TargetId) & SubscribedCategories;
+			Query.CategoryIndex = FAdvancedSightListenerProfile::GetCategoryIndex(Categories);
+			QueriedTargets.Add(Query.TargetId);
+		}
+	}
+
+	for (const TTuple<uint32, TWeakObjectPtr<AActor>>& TargetActor : TargetActors)
+	{
+		if (TargetActor.Value.IsValid() && !QueriedTargets.Contains(TargetActor.Key))
+		{
+			AddQuery(SightComponent, TargetActor.Value.Get(), SightComponent->GetSightData());
+		}
+	}
+}
+
+void UAdvancedSightSystem::ApplyTargetCategories(const AActor* TargetActor)
+{
+	const uint32 TargetId = TargetActor->GetUniqueID();
+	uint8* Categories = TargetCategories.Find(TargetId);
+	if (!Categories)
+	{
+		return;
+	}
+
+	*Categories = GetTargetCategories(TargetActor);
+	const uint8 NewCategories = *Categories;
+	RemoveUnsubscribedQueries([this, TargetId, NewCategories](const FAdvancedSightQuery& Query)
+	{
+		const UAdvancedSightComponent* SightComponent = Listeners.FindRef(Query.ListenerId).Get();
+		return Query.TargetId == TargetId
+			&& (!SightComponent || (SightComponent->GetSubscribedCategories() & NewCategories) == 0);
+	});
+
+	TSet<uint32> QueriedListeners;
+	for (FAdvancedSightQuery& Query : Queries)
+	{
+		if (Query.TargetId == TargetId && !Query.bIsRemoved)
+		{
+			const uint8 SubscribedCategories = Listeners.FindRef(Query.ListenerId)->GetSubscribedCategories();
+			Query.CategoryIndex = FAdvancedSightListenerProfile::GetCategoryIndex(NewCategories & SubscribedCategories);
+			QueriedListeners.Add(Query.ListenerId);
+		}
+	}
+
+	for (const TTuple<uint32, TWeakObjectPtr<UAdvancedSightComponent>>& Listener : Listeners)
+	{
+		if (Listener.Value.IsValid() && !QueriedListeners.Contains(Listener.Key))
+		{
+			AddQuery(Listener.Value.Get(), TargetActor, Listener.Value->GetSightData());
+		}
+	}
+}
+
+void UAdvancedSightSystem::RegisterIlluminationGrid(const UAdvancedSightIlluminationGrid* IlluminationGrid)
+{
+	IlluminationGrids.AddUnique(IlluminationGrid);
+}
+
+void UAdvancedSightSystem::UnregisterIlluminationGrid(const UAdvancedSightIlluminationGrid* IlluminationGrid)
+{
+	IlluminationGrids.Remove(IlluminationGrid);
+}
+
+void UAdvancedSightSystem::RegisterLight(const UAdvancedSightLightComponent* LightComponent)
+{
+	Lights.AddUnique(LightComponent);
+}
+
+void UAdvancedSightSystem::UnregisterLight(const UAdvancedSightLightComponent* LightComponent)
+{
+	Lights.Remove(LightComponent);
+}
+
+void UAdvancedSightSystem::RegisterOccluder(const UAdvancedSightOccluderComponent* OccluderComponent)
+{
+	UnregisterOccluder(OccluderComponent);
+
+	TArray<const UPrimitiveComponent*>& Primitives = OccluderPrimitives.Add(OccluderComponent);
+	OccluderComponent->GetOwner()->ForEachComponent<UPrimitiveComponent>(false,
+		[this, OccluderComponent, &Primitives](const UPrimitiveComponent* PrimitiveComponent)
+		{
+			TransmittanceTable.Components.Add(PrimitiveComponent, OccluderComponent->GetTransmittance());
+			Primitives.Add(PrimitiveComponent);
+		});
+}
+
+void UAdvancedSightSystem::UnregisterOccluder(const UAdvancedSightOccluderComponent* OccluderComponent)
+{
+	TArray<const UPrimitiveComponent*> Primitives;
+	if (OccluderPrimitives.RemoveAndCopyValue(OccluderComponent, Primitives))
+	{
+		for (const UPrimitiveComponent* PrimitiveComponent : Primitives)
+		{
+			TransmittanceTable.Components.Remove(PrimitiveComponent);
+		}
+	}
+}
+
+bool UAdvancedSightSystem::LoadVisibilitySet(const FString& LevelPackageName)
+{
+	const FString FilePath = FAdvancedSightVisibilitySet::GetFilePathForLevel(LevelPackageName);
+	TUniquePtr<FAdvancedSightVisibilitySet> VisibilitySet = MakeUnique<FAdvancedSightVisibilitySet>();
+	if (!VisibilitySet->Open(FilePath))
+	{
+		UE_LOG(LogAdvancedSight, Warning, TEXT("No visibility set baked for %s at %s"), *LevelPackageName, *FilePath);
+		return false;
+	}
+
+	UnloadVisibilitySet(LevelPackageName);
+	VisibilitySets.Add(VisibilitySet.Get());
+	LoadedVisibilitySets.Add(LevelPackageName, MoveTemp(VisibilitySet));
+	return true;
+}
+
+void UAdvancedSightSystem::UnloadVisibilitySet(const FString& LevelPackageName)
+{
+	TUniquePtr<FAdvancedSightVisibilitySet> VisibilitySet;
+	if (LoadedVisibilitySets.RemoveAndCopyValue(LevelPackageName, VisibilitySet))
+	{
+		VisibilitySets.Remove(VisibilitySet.Get());
+	}
+}
+
+float UAdvancedSightSystem::GetGainValueForTarget(const uint32 ListenerId, const uint32 TargetId) const
+{
+	const int32 QueryIndex = FindQueryIndex(ListenerId, TargetId);
+	if (QueryIndex == INDEX_NONE)
+	{
+		return -1.0f;
+	}
+
+	return Queries[QueryIndex].GainValue;
+}
+
+FVector UAdvancedSightSystem::GetLastKnownLocationFor(const uint32 ListenerId, const uint32 TargetId) const
+{
+	const int32 QueryIndex = FindQueryIndex(ListenerId, TargetId);
+	if (QueryIndex == INDEX_NONE)
+	{
+		return FVector::ZeroVector;
+	}
+
+	return QueriesColdData[QueryIndex].LastSeenLocation;
+}
+
+void UAdvancedSightSystem::SetSignificanceFunction(FSignificanceFunction InSignificanceFunction)
+{
+	SignificanceFunction = MoveTemp(InSignificanceFunction);
+}
+
+bool UAdvancedSightSystem::IsListenerDormant(const uint32 ListenerId) const
+{
+	return DormantListeners.Contains(ListenerId);
+}
+
+int32 UAdvancedSightSystem::GetNumDormantListeners() const
+{
+	return DormantListeners.Num();
+}
+
+void UAdvancedSightSystem::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+	{
+		const UWorld* World = GetWorld();
+		const FOnActorSpawned::FDelegate ActorSpawnedDelegate =
+			FOnActorSpawned::FDelegate::CreateUObject(this, &ThisClass::HandleNewActorSpawned);
+		NewActorSpawnedDelegateHandle = World->AddOnActorSpawnedHandler(ActorSpawnedDelegate);
+
+		CVarShouldDebugDraw.AsVariable()->SetOnChangedCallback(
+			FConsoleVariableDelegate::CreateUObject(this, &ThisClass::OnDebugDrawStateChanged));
+		bShouldDebugDraw = CVarShouldDebugDraw.GetValueOnGameThread();
+
+		HearingSense = MakeShared<FAdvancedSenseHearing>();
+		AddSense(HearingSense.ToSharedRef());
+		AddSense(MakeShared<FAdvancedSenseProximity>());
+
+		const UAdvancedSightSettings* Settings = GetDefault<UAdvancedSightSettings>();
+		for (const FAdvancedSightMaterialTransmittance& Entry : Settings->MaterialTransmittance)
+		{
+			if (const UPhysicalMaterial* PhysicalMaterial = Entry.PhysicalMaterial.LoadSynchronous())
+			{
+				TransmittanceTable.Materials.Add(PhysicalMaterial, FMath::Clamp(Entry.Transmittance, 0.0f, 1.0f));
+			}
+		}
+	}
+}
+
+void UAdvancedSightSystem::AddSense(TSharedRef<FAdvancedSenseBase> Sense)
+{
+	Senses.Add(MoveTemp(Sense));
+}
+
+void UAdvancedSightSystem::ReportNoiseEvent(const FVector& Location, float Loudness, AActor* Instigator, float MaxRange)
+{
+	if (HearingSense.IsValid())
+	{
+		HearingSense->ReportNoiseEvent(Location, Loudness, Instigator, MaxRange);
+	}
+}
+
+void UAdvancedSightSystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::Tick");
+
+	const UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+
+	if (bShouldApplyPendingSnapshot)
+	{
+		bShouldApplyPendingSnapshot = false;
+		ApplyPerceptionSnapshot(PendingSnapshot);
+	}
+	if (!PendingSnapshot.IsEmpty() && World->GetTimeSeconds() >= PendingSnapshotExpireTime)
+	{
+		UE_LOG(LogAdvancedSight, Verbose, TEXT("Dropping %d query and %d listener records of a restored perception state"),
+			PendingSnapshot.Queries.Num(), PendingSnapshot.Listeners.Num());
+		PendingSnapshot.Reset();
+	}
+
+	int32 NumEvaluatedQueries = 0;
+	const UAdvancedSightSettings* Settings = GetDefault<UAdvancedSightSettings>();
+	if (!Settings->bUseFixedUpdateRate || Settings->FixedUpdateRate <= 0.0f)
+	{
+		NumEvaluatedQueries = UpdateSight(DeltaTime, INDEX_NONE, true);
+	}
+	else
+	{
+		const float StepTime = 1.0f / Settings->FixedUpdateRate;
+		const int32 NumStaggerGroups = FMath::Max(Settings->NumStaggerGroups, 1);
+		UpdateAccumulator += DeltaTime;
+		int32 NumSubsteps = 0;
+		while (UpdateAccumulator >= StepTime && NumSubsteps < Settings->MaxSubstepsPerFrame)
+		{
+			UpdateAccumulator -= StepTime;
+			NumSubsteps++;
+			// Every listener is updated once per NumStaggerGroups substeps, so it integrates the time of all of them
+			const int32 StaggerGroup = NumStaggerGroups > 1 ? NextStaggerGroup : INDEX_NONE;
+			NextStaggerGroup = (NextStaggerGroup + 1) % NumStaggerGroups;
+			NumEvaluatedQueries += UpdateSight(StepTime * NumStaggerGroups, StaggerGroup, true);
+		}
+
+		if (UpdateAccumulator >= StepTime)
+		{
+			// Drop the time of a hitch instead of catching up over the next frames
+			UpdateAccumulator = FMath::Fmod(UpdateAccumulator, StepTime);
+		}
+
+		if (NumSubsteps == 0 && !PendingVisibilityRequests.IsEmpty())
+		{
+			UpdateSight(0.0f, INDEX_NONE, false);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_AdvancedSight_Listeners, Listeners.Num());
+	SET_DWORD_STAT(STAT_AdvancedSight_DormantListeners, DormantListeners.Num());
+	SET_DWORD_STAT(STAT_AdvancedSight_Queries, Queries.Num());
+	SET_DWORD_STAT(STAT_AdvancedSight_ActiveQueries, NumEvaluatedQueries);
+	SET_DWORD_STAT(STAT_AdvancedSight_Shards, ShardGrid.Num());
+
+	if (bShouldDebugDraw && DebugListener.IsValid())
+	{
+		DrawDebug(DebugListener.Get());
+	}
+}
+
+int32 UAdvancedSightSystem::UpdateSight(const float DeltaTime, const int32 StaggerGroup, const bool bUpdateQueries)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::UpdateSight");
+
+	const UWorld* World = GetWorld();
+	UpdateListenersDormancy();
+	GatherTargetSnapshots();
+	GatherIllumination();
+	ApplyPendingCategoryChanges();
+	ConditionalRebuildQueryLayout();
+	ActiveQueryIndices.Reset();
+	ActiveQueryListenerIndices.Reset();
+	ActiveListeners.Reset();
+	if (bUpdateQueries)
+	{
+		GatherActiveListeners(StaggerGroup);
+		BuildShards();
+		GatherActiveQueries();
+	}
+	PrepareVisibilityRequests();
+
+	// Other senses run together with the queries and share their listener and target snapshots, each sense decides
+	// whether it only processes listeners of the current stagger group
+	const FAdvancedSenseUpdateContext SenseContext(DeltaTime, ActiveListeners, TargetSnapshots, ShardGrid);
+	SenseWorkItemOffsets.Reset();
+	int32 NumSenseWorkItems = 0;
+	for (const TSharedRef<FAdvancedSenseBase>& Sense : Senses)
+	{
+		SenseWorkItemOffsets.Add(NumSenseWorkItems);
+		NumSenseWorkItems += bUpdateQueries ? Sense->PrepareUpdate(SenseContext) : 0;
+	}
+	SenseWorkItemOffsets.Add(NumSenseWorkItems);
+
+	FAdvancedSightWorldContext WorldContext;
+	WorldContext.World = World;
+	const UAdvancedSightSettings* Settings = GetDefault<UAdvancedSightSettings>();
+	WorldContext.CollisionChannel = Settings->AdvancedSightCollisionChannel;
+	WorldContext.Illumination = &Illumination;
+	if (CVarUseVisibilitySets.GetValueOnGameThread())
+	{
+		WorldContext.VisibilitySets = VisibilitySets;
+	}
+
+	if (Settings->bEnablePartialOcclusion)
+	{
+		WorldContext.TransmittanceTable = &TransmittanceTable;
+		WorldContext.MaxOcclusionHits = Settings->MaxOcclusionHits;
+		WorldContext.MinTransmittance = Settings->MinTransmittance;
+	}
+
+	const int32 NumActiveQueries = ActiveQueryIndices.Num();
+	const int32 NumEvaluations = NumActiveQueries + VisibilityRequests.Num();
+	const int32 NumWorkItems = NumEvaluations + NumSenseWorkItems;
+	ParallelFor(NumWorkItems, [this, &WorldContext, NumActiveQueries, NumEvaluations, &SenseContext](int32 Index)
+	{
+		if (Index >= NumEvaluations)
+		{
+			const int32 WorkItemIndex = Index - NumEvaluations;
+			int32 SenseIndex = 0;
+			while (WorkItemIndex >= SenseWorkItemOffsets[SenseIndex + 1])
+			{
+				SenseIndex++;
+			}
+
+			Senses[SenseIndex]->EvaluateWorkItem(WorkItemIndex - SenseWorkItemOffsets[SenseIndex], SenseContext);
+			return;
+		}
+
+		if (Index >= NumActiveQueries)
+		{
+			FAdvancedSightVisibilityRequest& Request = VisibilityRequests[Index - NumActiveQueries];
+			if (Request.ResolvedSightComponent)
+			{
+				EvaluateVisibility(
+					Request.Query,
+					Request.Profile,
+					Request.Eye,
+					Request.VisibilityPoints,
+					Request.ResolvedTargetActor,
+					WorldContext);
+			}
+			return;
+		}
+
+		FAdvancedSightQuery& Query = Queries[ActiveQueryIndices[Index]];
+		const FAdvancedSightActiveListener& ActiveListener = ActiveListeners[ActiveQueryListenerIndices[Index]];
+		const FAdvancedSightTargetSnapshot& TargetSnapshot = TargetSnapshots[Query.TargetId];
+		EvaluateVisibility(
+			Query,
+			*ActiveListener.Profile,
+			ActiveListener.Eye,
+			TargetSnapshot.VisibilityPoints,
+			TargetSnapshot.Actor,
+			WorldContext);
+	},
+	false);
+
+	// All states are updated before any callback or delegate runs, as those may register listeners, which moves the
+	// profiles
+	const float ReportDistanceSq = FMath::Square(GetDefault<UAdvancedSightSettings>()->LastSeenLocationReportDistance);
+	ActiveQueryTransitions.SetNumUninitialized(NumActiveQueries);
+	ActiveQueriesMoved.Init(false, NumActiveQueries);
+	for (int32 Index = 0; Index < NumActiveQueries; Index++)
+	{
+		const int32 QueryIndex = ActiveQueryIndices[Index];
+		FAdvancedSightQuery& Query = Queries[QueryIndex];
+		const FAdvancedSightListenerProfile& Profile = *ActiveListeners[ActiveQueryListenerIndices[Index]].Profile;
+		const bool bHadState = Query.HasState();
+		ActiveQueryTransitions[Index] = UpdateQueryState(Query, Profile, DeltaTime);
+		if (Query.HasState() != bHadState)
+		{
+			UpdateStatefulTarget(Query);
+		}
+		FAdvancedSightQueryColdData& ColdData = QueriesColdData[QueryIndex];
+		if (Query.bIsCurrentCheckSuccess)
+		{
+			ColdData.LastSeenLocation = TargetSnapshots[Query.TargetId].Location;
+			// Reported along with transitions too, so a target seen again is never left at a stale location
+			if (ActiveQueryTransitions[Index] != EAdvancedSightTransition::None
+				|| FVector::DistSquared(ColdData.LastSeenLocation, ColdData.ReportedLocation) > ReportDistanceSq)
+			{
+				ColdData.ReportedLocation = ColdData.LastSeenLocation;
+				ActiveQueriesMoved[Index] = true;
+			}
+		}
+	}
+
+	CompleteVisibilityRequests();
+
+	// Delegates may unregister listeners and targets, which only tombstones their queries, or register new ones, which
+	// may reallocate the query arrays. Queries are therefore looked up again after every call out.
+	for (int32 Index = 0; Index < NumActiveQueries; Index++)
+	{
+		const int32 QueryIndex = ActiveQueryIndices[Index];
+		if (Queries[QueryIndex].bIsRemoved)
+		{
+			continue;
+		}
+
+		const EAdvancedSightTransition Transitions = ActiveQueryTransitions[Index];
+		const bool bHasMoved = ActiveQueriesMoved[Index];
+		const uint32 ListenerId = Queries[QueryIndex].ListenerId;
+		const uint32 TargetId = Queries[QueryIndex].TargetId;
+		const TWeakObjectPtr<UAdvancedSightComponent>* Listener = Listeners.Find(ListenerId);
+		const TWeakObjectPtr<AActor>* TargetActor = TargetActors.Find(TargetId);
+		if (!Listener || !Listener->IsValid() || !TargetActor || !TargetActor->IsValid())
+		{
+			continue;
+		}
+
+		if (bHasMoved)
+		{
+			(*Listener)->OnTargetLastSeenLocationChanged.Broadcast(
+				TargetActor->Get(), QueriesColdData[QueryIndex].LastSeenLocation);
+		}
+
+		if (Transitions != EAdvancedSightTransition::None && !Queries[QueryIndex].bIsRemoved)
+		{
+			DispatchTransitions(ListenerId, TargetId, Transitions);
+		}
+
+		// Only a change of the quantized value is worth sending to clients and gain listeners
+		FAdvancedSightQuery& Query = Queries[QueryIndex];
+		const uint8 QuantizedGain = FAdvancedSightReplicatedTarget::QuantizeGain(Query.GainValue);
+		if (QuantizedGain != Query.QuantizedGain && !Query.bIsRemoved)
+		{
+			Query.QuantizedGain = QuantizedGain;
+			if (UAdvancedSightComponent* SightComponent = Listeners.FindRef(ListenerId).Get())
+			{
+				SightComponent->SetQuantizedGain(TargetActors.FindRef(TargetId).Get(), QuantizedGain);
+			}
+		}
+	}
+
+	if (bUpdateQueries)
+	{
+		for (const TSharedRef<FAdvancedSenseBase>& Sense : Senses)
+		{
+			Sense->FinishUpdate(SenseContext, SenseEvents);
+		}
+		DispatchSenseEvents();
+	}
+
+	if (Recorder.IsValid() && bUpdateQueries)
+	{
+		RecordFrame(DeltaTime);
+	}
+
+	return NumActiveQueries;
+}
+
+TStatId UAdvancedSightSystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAdvancedSightSystem, STATGROUP_Tickables);
+}
+
+void UAdvancedSightSystem::HandleNewActorSpawned(AActor* Actor)
+{
+	RegisterTarget(Actor);
+}
+
+void UAdvancedSightSystem::UpdateListenersDormancy()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::UpdateListenersDormancy");
+
+	DormantListeners.Reset();
+	if (!GetDefault<UAdvancedSightSettings>()->bEnableListenerDormancy)
+	{
+		return;
+	}
+
+	PlayerPawnLocations.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && PlayerController->GetPawn())
+		{
+			PlayerPawnLocations.Add(PlayerController->GetPawn()->GetActorLocation());
+		}
+	}
+
+	for (const TTuple<uint32, TWeakObjectPtr<UAdvancedSightComponent>>& Listener : Listeners)
+	{
+		const UAdvancedSightComponent* SightComponent = Listener.Value.Get();
+		if (!SightComponent || ShouldListenerBeDormant(SightComponent))
+		{
+			DormantListeners.Add(Listener.Key);
+		}
+	}
+}
+
+bool UAdvancedSightSystem::ShouldListenerBeDormant(const UAdvancedSightComponent* SightComponent) const
+{
+	if (!SightComponent->IsActive())
+	{
+		return true;
+	}
+
+	const AActor* BodyActor = SightComponent->GetBodyActor();
+	if (!BodyActor || BodyActor->IsHidden())
+	{
+		return true;
+	}
+
+	const ULevel* Level = BodyActor->GetLevel();
+	if (Level && !Level->bIsVisible)
+	{
+		return true;
+	}
+
+	const float Significance =
+		SignificanceFunction ? SignificanceFunction(SightComponent) : CalculateDefaultSignificance(SightComponent);
+	return Significance <= GetDefault<UAdvancedSightSettings>()->DormancySignificanceThreshold;
+}
+
+float UAdvancedSightSystem::CalculateDefaultSignificance(const UAdvancedSightComponent* SightComponent) const
+{
+	const float DormancyDistance = GetDefault<UAdvancedSightSettings>()->DormancyDistance;
+	if (PlayerPawnLocations.IsEmpty() || DormancyDistance <= 0.0f)
+	{
+		return 1.0f;
+	}
+
+	const FVector ListenerLocation = SightComponent->GetBodyActor()->GetActorLocation();
+	float MinDistanceSq = MAX_flt;
+	for (const FVector& PlayerPawnLocation : PlayerPawnLocations)
+	{
+		MinDistanceSq = FMath::Min(MinDistanceSq, static_cast<float>(FVector::DistSquared(ListenerLocation, PlayerPawnLocation)));
+	}
+
+	return 1.0f - FMath::Clamp(FMath::Sqrt(MinDistanceSq) / DormancyDistance, 0.0f, 1.0f);
+}
+
+void UAdvancedSightSystem::AddQuery(
+	const UAdvancedSightComponent* SightComponent, const AActor* TargetActor, const UAdvancedSightData* SightData)
+{
+	if (!SightData)
+	{
+		return;
+	}
+	
+	if (SightComponent->GetOwner() == TargetActor)
+	{
+		return;
+	}
+
+	const uint8 Categories =
+		TargetCategories.FindRef(TargetActor->GetUniqueID()) & SightComponent->GetSubscribedCategories();
+	if (Categories == 0)
+	{
+		return;
+	}
+
+	if (SightComponent->GetBodyActor()->Implements<UGenericTeamAgentInterface>()
+		&& TargetActor->Implements<UGenericTeamAgentInterface>())
+	{
+		const auto* ListenerTeamAgent = Cast<IGenericTeamAgentInterface>(SightComponent->GetBodyActor());
+		const auto* TargetTeamAgent = Cast<IGenericTeamAgentInterface>(TargetActor);
+		const bool bShouldSense = FAISenseAffiliationFilter::ShouldSenseTeam(
+			ListenerTeamAgent->GetGenericTeamId(),
+			TargetTeamAgent->GetGenericTeamId(),
+			SightData->DetectionByAffiliation.GetAsFlags());
+		if (!bShouldSense)
+		{
+			return;
+		}
+	}
+
+	FAdvancedSightQuery& Query = Queries.AddDefaulted_GetRef();
+	Query.ListenerId = SightComponent->GetUniqueID();
+	Query.TargetId = TargetActor->GetUniqueID();
+	Query.CategoryIndex = FAdvancedSightListenerProfile::GetCategoryIndex(Categories);
+	QueriesColdData.AddDefaulted();
+	bIsQueryLayoutDirty = true;
+}
+
+void UAdvancedSightSystem::RequestVisibility(
+	const UAdvancedSightComponent* SightComponent,
+	const AActor* TargetActor,
+	UAdvancedSightData* SightData,
+	FAdvancedSightVisibilityDelegate OnCompleted)
+{
+	FAdvancedSightVisibilityRequest& Request = PendingVisibilityRequests.AddDefaulted_GetRef();
+	Request.SightComponent = SightComponent;
+	Request.TargetActor = TargetActor;
+	Request.bHasTargetActor = true;
+	Request.SightData = SightData;
+	Request.OnCompleted = [OnCompleted](const FAdvancedSightVisibilityResult& Result)
+	{
+		OnCompleted.ExecuteIfBound(Result);
+	};
+}
+
+void UAdvancedSightSystem::RequestVisibility(
+	const UAdvancedSightComponent* SightComponent,
+	const FVector& TargetPoint,
+	UAdvancedSightData* SightData,
+	FAdvancedSightVisibilityDelegate OnCompleted)
+{
+	FAdvancedSightVisibilityRequest& Request = PendingVisibilityRequests.AddDefaulted_GetRef();
+	Request.SightComponent = SightComponent;
+	Request.TargetPoint = TargetPoint;
+	Request.SightData = SightData;
+	Request.OnCompleted = [OnCompleted](const FAdvancedSightVisibilityResult& Result)
+	{
+		OnCompleted.ExecuteIfBound(Result);
+	};
+}
+
+TFuture<FAdvancedSightVisibilityResult> UAdvancedSightSystem::RequestVisibilityAsync(
+	const UAdvancedSightComponent* SightComponent, const AActor* TargetActor, UAdvancedSightData* SightData)
+{
+	TSharedRef<TPromise<FAdvancedSightVisibilityResult>> Promise =
+		MakeShared<TPromise<FAdvancedSightVisibilityResult>>();
+	FAdvancedSightVisibilityRequest& Request = PendingVisibilityRequests.AddDefaulted_GetRef();
+	Request.SightComponent = SightComponent;
+	Request.TargetActor = TargetActor;
+	Request.bHasTargetActor = true;
+	Request.SightData = SightData;
+	Request.OnCompleted = [Promise](const FAdvancedSightVisibilityResult& Result)
+	{
+		Promise->SetValue(Result);
+	};
+	return Promise->GetFuture();
+}
+
+TFuture<FAdvancedSightVisibilityResult> UAdvancedSightSystem::RequestVisibilityAsync(
+	const UAdvancedSightComponent* SightComponent, const FVector& TargetPoint, UAdvancedSightData* SightData)
+{
+	TSharedRef<TPromise<FAdvancedSightVisibilityResult>> Promise =
+		MakeShared<TPromise<FAdvancedSightVisibilityResult>>();
+	FAdvancedSightVisibilityRequest& Request = PendingVisibilityRequests.AddDefaulted_GetRef();
+	Request.SightComponent = SightComponent;
+	Request.TargetPoint = TargetPoint;
+	Request.SightData = SightData;
+	Request.OnCompleted = [Promise](const FAdvancedSightVisibilityResult& Result)
+	{
+		Promise->SetValue(Result);
+	};
+	return Promise->GetFuture();
+}
+
+void UAdvancedSightSystem::EvaluateQueryVisibility(
+	FAdvancedSightQuery& Query,
+	const FAdvancedSightListenerProfile& Profile,
+	const FVector& EyeLocation,
+	const FVector& EyeForward,
+	TConstArrayView<FVector> VisibilityPoints,
+	FLineOfSightFunction LineOfSightFunction,
+	FIlluminationFunction IlluminationFunction)
+{
+	Query.bIsCurrentCheckSuccess = false;
+	Query.TracedPointsMask = 0;
+	Query.ClearPointsMask = 0;
+	ResetPointsVisibility(Query.bTargetVisibilityPointsFlag);
+	const int32 NumPoints = FMath::Min(VisibilityPoints.Num(), FAdvancedSightQuery::MaxVisibilityPoints);
+	if (Query.bIsTargetPerceived)
+	{
+		const float LoseSightRadiusSq = FMath::Square(Profile.Categories[Query.CategoryIndex].LoseSightRadius);
+		uint32 PointsMask = 0;
+		for (int32 Index = 0; Index < NumPoints; Index++)
+		{
+			const bool bIsInside = FVector::DistSquared(EyeLocation, VisibilityPoints[Index]) <= LoseSightRadiusSq;
+			PointsMask |= static_cast<uint32>(bIsInside) << Index;
+		}
+
+		Query.bIsCurrentCheckSuccess = FindVisiblePoint(Query, PointsMask, LineOfSightFunction) != INDEX_NONE;
+		return;
+	}
+
+	// Points are moved into eye space once and every cone shape tests all of them in its own kernel, then cones are
+	// walked from the closest one and each point is traced at most once
+	const FMatrix EyeMatrix = FRotationMatrix::MakeFromX(EyeForward);
+	const FVector EyeRight = EyeMatrix.GetScaledAxis(EAxis::Y);
+	const FVector EyeUp = EyeMatrix.GetScaledAxis(EAxis::Z);
+	TArray<FAdvancedSightEyeSpacePoint, TInlineAllocator<FAdvancedSightQuery::MaxVisibilityPoints>> EyeSpacePoints;
+	for (int32 Index = 0; Index < NumPoints; Index++)
+	{
+		const FVector Offset = VisibilityPoints[Index] - EyeLocation;
+		FAdvancedSightEyeSpacePoint& EyeSpacePoint = EyeSpacePoints.AddDefaulted_GetRef();
+		EyeSpacePoint.Location = FVector(
+			FVector::DotProduct(Offset, EyeForward), FVector::DotProduct(Offset, EyeRight), FVector::DotProduct(Offset, EyeUp));
+		EyeSpacePoint.DistanceSq = Offset.SizeSquared();
+	}
+
+	constexpr float EPSILON = 1.0f;
+	const float RadiusBias = Query.bWasLastCheckSuccess ? EPSILON : 0.0f;
+	TArray<uint32, TInlineAllocator<8>> ConePointMasks;
+	ConePointMasks.SetNumUninitialized(Profile.Cones.Num());
+	AdvancedSightShapeKernels::GatherPointsInsideCones(Profile, EyeSpacePoints, RadiusBias, ConePointMasks.GetData());
+	for (int32 ConeIndex = 0; ConeIndex < Profile.Cones.Num(); ConeIndex++)
+	{
+		const FAdvancedSightCone& Cone = Profile.Cones[ConeIndex];
+		const int32 VisiblePointIndex = FindVisiblePoint(Query, ConePointMasks[ConeIndex], LineOfSightFunction);
+		if (VisiblePointIndex != INDEX_NONE)
+		{
+			Query.bIsCurrentCheckSuccess = true;
+			Query.CurrentGainMultiplier = Cone.GainMultiplier * Profile.Categories[Query.CategoryIndex].GainMultiplier;
+			if (Cone.GainTable.IsValid())
+			{
+				Query.CurrentGainMultiplier *=
+					SampleGainTable(Cone, EyeLocation, EyeForward, VisibilityPoints[VisiblePointIndex]);
+			}
+
+			// Quantized so a recording reproduces the exact gain rate
+			Query.Illumination = FAdvancedSightIllumination::Quantize(IlluminationFunction(VisiblePointIndex));
+			Query.CurrentGainMultiplier *= FMath::Lerp(
+				Profile.DarknessGainMultiplier, 1.0f, FAdvancedSightIllumination::Dequantize(Query.Illumination));
+			Query.CurrentGainMultiplier *= FAdvancedSightTransmittanceTable::Dequantize(Query.Transmittance);
+			break;
+		}
+	}
+}
+
+float UAdvancedSightSystem::SampleGainTable(
+	const FAdvancedSightCone& Cone, const FVector& EyeLocation, const FVector& EyeForward, const FVector& Point)
+{
+	const FVector ToPoint = Point - EyeLocation;
+	const float Distance = ToPoint.Size();
+	const float DotProduct = FMath::Clamp(FVector::DotProduct(ToPoint.GetSafeNormal(), EyeForward), -1.0f, 1.0f);
+	const float Angle = FMath::Acos(DotProduct);
+	// Boxes have no angle, their angle curve is sampled at the center
+	const float MaxAngle =
+		Cone.Shape != EAdvancedSightConeShape::Box ? FMath::DegreesToRadians(Cone.FOV / 2.0f) : 0.0f;
+	const float NormalizedDistance = Cone.GainRadius > 0.0f ? Distance / Cone.GainRadius : 0.0f;
+	const float NormalizedAngle = MaxAngle > 0.0f ? Angle / MaxAngle : 0.0f;
+	return Cone.GainTable->Sample(NormalizedDistance, NormalizedAngle);
+}
+
+EAdvancedSightTransition UAdvancedSightSystem::UpdateQueryState(
+	FAdvancedSightQuery& Query, const FAdvancedSightListenerProfile& Profile, const float DeltaTime)
+{
+	EAdvancedSightTransition Transitions = EAdvancedSightTransition::None;
+	if (Query.bIsCurrentCheckSuccess)
+	{
+		if (!Query.bWasLastCheckSuccess)
+		{
+			Query.bWasLastCheckSuccess = true;
+			Transitions |= EAdvancedSightTransition::Spotted;
+		}
+
+		if (!Query.bIsTargetPerceived)
+		{
+			Query.GainValue += DeltaTime * Query.CurrentGainMultiplier;
+			if (Query.GainValue > 1.0f)
+			{
+				Query.bIsTargetPerceived = true;
+				Transitions |= EAdvancedSightTransition::Perceived;
+			}
+		}
+		else
+		{
+			Query.LoseSightTimer = 0.0f;
+		}
+	}
+	else
+	{
+		if (Query.bWasLastCheckSuccess)
+		{
+			Query.bWasLastCheckSuccess = false;
+			Transitions |= EAdvancedSightTransition::Lost;
+		}
+
+		if (Query.bIsTargetPerceived)
+		{
+			Query.LoseSightTimer += DeltaTime;
+			if (Query.LoseSightTimer >= Profile.Categories[Query.CategoryIndex].LoseSightCooldown)
+			{
+				Query.bIsTargetPerceived = false;
+				Transitions |= EAdvancedSightTransition::Forgot;
+			}
+		}
+		else
+		{
+			Query.GainValue -= DeltaTime;
+			if (Query.GainValue < 0.0f)
+			{
+				Query.GainValue = 0.0f;
+			}
+		}
+	}
+
+	return Transitions;
+}
+
+void UAdvancedSightSystem::DispatchTransitions(
+	const uint32 ListenerId, const uint32 TargetId, const EAdvancedSightTransition Transitions)
+{
+	if (Recorder.IsValid())
+	{
+		RecordedFrame.Transitions.Add({ ListenerId, TargetId, Transitions });
+	}
+
+	UAdvancedSightComponent* SightComponent = Listeners.FindRef(ListenerId).Get();
+	AActor* TargetActor = TargetActors.FindRef(TargetId).Get();
+	if (!SightComponent || !TargetActor)
+	{
+		return;
+	}
+
+	if (EnumHasAnyFlags(Transitions, EAdvancedSightTransition::Spotted))
+	{
+		SightComponent->SpotTarget(TargetActor);
+	}
+
+	if (EnumHasAnyFlags(Transitions, EAdvancedSightTransition::Perceived))
+	{
+		SightComponent->PerceiveTarget(TargetActor);
+	}
+
+	if (EnumHasAnyFlags(Transitions, EAdvancedSightTransition::Lost))
+	{
+		SightComponent->LoseTarget(TargetActor);
+	}
+
+	if (EnumHasAnyFlags(Transitions, EAdvancedSightTransition::Forgot))
+	{
+		SightComponent->ForgetTarget(TargetActor);
+	}
+}
+
+bool UAdvancedSightSystem::StartRecording(const FString& FilePath)
+{
+	StopRecording();
+
+	TUniquePtr<FAdvancedSightRecorder> NewRecorder = MakeUnique<FAdvancedSightRecorder>();
+	if (!NewRecorder->Open(FilePath))
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Failed to start sight recording to %s"), *FilePath);
+		return false;
+	}
+
+	Recorder = MoveTemp(NewRecorder);
+	RecordedFrame.Reset();
+	RecordedFrame.InitialQueryStates.Reserve(Queries.Num());
+	for (const FAdvancedSightQuery& Query : Queries)
+	{
+		if (Query.bIsRemoved)
+		{
+			continue;
+		}
+
+		RecordedFrame.InitialQueryStates.Add(
+			{
+				Query.ListenerId,
+				Query.TargetId,
+				Query.GainValue,
+				Query.LoseSightTimer,
+				static_cast<bool>(Query.bWasLastCheckSuccess),
+				static_cast<bool>(Query.bIsTargetPerceived),
+				static_cast<uint8>(Query.CategoryIndex)
+			});
+	}
+
+	UE_LOG(LogAdvancedSight, Log, TEXT("Started sight recording to %s"), *FilePath);
+	return true;
+}
+
+void UAdvancedSightSystem::StopRecording()
+{
+	if (!Recorder.IsValid())
+	{
+		return;
+	}
+
+	UE_LOG(
+		LogAdvancedSight,
+		Log,
+		TEXT("Stopped sight recording to %s after %d frames"),
+		*Recorder->GetFilePath(),
+		Recorder->GetNumFrames());
+	Recorder->Close();
+	Recorder.Reset();
+}
+
+bool UAdvancedSightSystem::IsRecording() const
+{
+	return Recorder.IsValid();
+}
+
+void UAdvancedSightSystem::SavePerceptionState(TArray<uint8>& OutData) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::SavePerceptionState");
+
+	FAdvancedSightPerceptionSnapshot Snapshot;
+	TMap<uint32, int32> ListenerIndices;
+	TMap<const AActor*, int32> ActorIndices;
+	auto FindOrAddActorIndex = [&Snapshot, &ActorIndices](const AActor* Actor)
+	{
+		if (const int32* ActorIndex = ActorIndices.Find(Actor))
+		{
+			return *ActorIndex;
+		}
+
+		const int32 ActorIndex = Snapshot.Ids.Add(GetPersistentId(Actor));
+		ActorIndices.Add(Actor, ActorIndex);
+		return ActorIndex;
+	};
+
+	Snapshot.Listeners.Reserve(Listeners.Num());
+	for (const TTuple<uint32, TWeakObjectPtr<UAdvancedSightComponent>>& Listener : Listeners)
+	{
+		const UAdvancedSightComponent* SightComponent = Listener.Value.Get();
+		const AActor* BodyActor = SightComponent ? SightComponent->GetBodyActor() : nullptr;
+		if (!BodyActor)
+		{
+			continue;
+		}
+
+		const int32 ListenerIndex = FindOrAddActorIndex(BodyActor);
+		ListenerIndices.Add(Listener.Key, ListenerIndex);
+		FAdvancedSightPersistentListener& PersistentListener = Snapshot.Listeners.AddDefaulted_GetRef();
+		PersistentListener.ListenerIndex = ListenerIndex;
+		auto AddTargets = [&FindOrAddActorIndex](const TArray<AActor*>& Targets, TArray<int32>& OutTargets)
+		{
+			OutTargets.Reserve(Targets.Num());
+			for (const AActor* Target : Targets)
+			{
+				if (Target)
+				{
+					OutTargets.Add(FindOrAddActorIndex(Target));
+				}
+			}
+		};
+		AddTargets(SightComponent->GetPerceivedTargets(), PersistentListener.PerceivedTargets);
+		AddTargets(SightComponent->GetSpottedTargets(), PersistentListener.SpottedTargets);
+		AddTargets(SightComponent->GetRememberedTargets(), PersistentListener.RememberedTargets);
+	}
+
+	Snapshot.Queries.Reserve(Queries.Num());
+	for (int32 QueryIndex = 0; QueryIndex < Queries.Num(); QueryIndex++)
+	{
+		const FAdvancedSightQuery& Query = Queries[QueryIndex];
+		const int32* ListenerIndex = ListenerIndices.Find(Query.ListenerId);
+		const TWeakObjectPtr<AActor>* TargetActor = TargetActors.Find(Query.TargetId);
+		if (Query.bIsRemoved || !ListenerIndex || !TargetActor || !TargetActor->IsValid())
+		{
+			continue;
+		}
+
+		FAdvancedSightPersistentQuery& PersistentQuery = Snapshot.Queries.AddDefaulted_GetRef();
+		PersistentQuery.ListenerIndex = *ListenerIndex;
+		PersistentQuery.TargetIndex = FindOrAddActorIndex(TargetActor->Get());
+		PersistentQuery.Flags = (Query.bWasLastCheckSuccess ? FAdvancedSightPersistentQuery::WasLastCheckSuccess : 0)
+			| (Query.bIsTargetPerceived ? FAdvancedSightPersistentQuery::IsTargetPerceived : 0);
+		PersistentQuery.GainValue = Query.GainValue;
+		PersistentQuery.LoseSightTimer = Query.LoseSightTimer;
+		PersistentQuery.LastSeenLocation = QueriesColdData[QueryIndex].LastSeenLocation;
+	}
+
+	OutData.Reset();
+	FMemoryWriter Writer(OutData);
+	Snapshot.Serialize(Writer);
+}
+
+bool UAdvancedSightSystem::RestorePerceptionState(const TArray<uint8>& Data)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::RestorePerceptionState");
+
+	FAdvancedSightPerceptionSnapshot Snapshot;
+	FMemoryReader Reader(Data);
+	if (!Snapshot.Serialize(Reader))
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Failed to restore perception state, data is invalid or outdated"));
+		return false;
+	}
+
+	ApplyPerceptionSnapshot(Snapshot);
+	PendingSnapshot = MoveTemp(Snapshot);
+	const UWorld* World = GetWorld();
+	PendingSnapshotExpireTime = (World ? World->GetTimeSeconds() : 0.0)
+		+ GetDefault<UAdvancedSightSettings>()->PendingSnapshotTimeout;
+	return true;
+}
+
+FString UAdvancedSightSystem::GetPersistentId(const AActor* Actor)
+{
+	// Without the PIE prefix a state saved in one play in editor session can be restored in another
+	return UWorld::RemovePIEPrefix(Actor->GetPathName());
+}
+
+void UAdvancedSightSystem::GatherDebugInfo(
+	const FVector& Origin, const float Radius, TArray<FAdvancedSightListenerDebugInfo>& OutListeners) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::GatherDebugInfo");
+
+	OutListeners.Reset();
+	TMap<uint32, int32> ListenerIndices;
+	const float RadiusSq = FMath::Square(Radius);
+	for (const TTuple<uint32, TWeakObjectPtr<UAdvancedSightComponent>>& Listener : Listeners)
+	{
+		const UAdvancedSightComponent* SightComponent = Listener.Value.Get();
+		const AActor* BodyActor = SightComponent ? SightComponent->GetBodyActor() : nullptr;
+		if (!BodyActor || FVector::DistSquared(BodyActor->GetActorLocation(), Origin) > RadiusSq)
+		{
+			continue;
+		}
+
+		ListenerIndices.Add(Listener.Key, OutListeners.Num());
+		FAdvancedSightListenerDebugInfo& ListenerInfo = OutListeners.AddDefaulted_GetRef();
+		ListenerInfo.ListenerId = Listener.Key;
+		ListenerInfo.Name = BodyActor->GetName();
+		GetEvaluatedEye(SightComponent, ListenerInfo.EyeLocation, ListenerInfo.EyeForward);
+		ListenerInfo.bIsDormant = DormantListeners.Contains(Listener.Key);
+		if (const FAdvancedSightListenerQueries* ListenerEntry = ListenerQueries.Find(Listener.Key))
+		{
+			ListenerInfo.LoseSightRadius = ListenerEntry->Profile.LoseSightRadius;
+			ListenerInfo.Cones = ListenerEntry->Profile.Cones;
+		}
+	}
+
+	for (int32 QueryIndex = 0; QueryIndex < Queries.Num(); QueryIndex++)
+	{
+		const FAdvancedSightQuery& Query = Queries[QueryIndex];
+		const int32* ListenerIndex = ListenerIndices.Find(Query.ListenerId);
+		if (Query.bIsRemoved || !ListenerIndex)
+		{
+			continue;
+		}
+
+		FAdvancedSightListenerDebugInfo& ListenerInfo = OutListeners[*ListenerIndex];
+		ListenerInfo.NumQueries++;
+
+		if (!Query.bWasLastCheckSuccess && !Query.bIsTargetPerceived && Query.GainValue <= 0.0f)
+		{
+			continue;
+		}
+
+		FAdvancedSightTargetDebugInfo& TargetInfo = ListenerInfo.Targets.AddDefaulted_GetRef();
+		TargetInfo.TargetId = Query.TargetId;
+		TargetInfo.LastSeenLocation = QueriesColdData[QueryIndex].LastSeenLocation;
+		TargetInfo.GainValue = Query.GainValue;
+		TargetInfo.bIsVisible = Query.bIsCurrentCheckSuccess;
+		TargetInfo.bIsPerceived = Query.bIsTargetPerceived;
+		TargetInfo.VisibilityPointsFlags = Query.bTargetVisibilityPointsFlag;
+		if (const FAdvancedSightTargetSnapshot* TargetSnapshot = TargetSnapshots.Find(Query.TargetId))
+		{
+			TargetInfo.Location = TargetSnapshot->Location;
+			TargetInfo.VisibilityPoints = TargetSnapshot->VisibilityPoints;
+		}
+	}
+}
+
+void UAdvancedSightSystem::Deinitialize()
+{
+	StopRecording();
+
+	// Nothing will evaluate the pending requests anymore, complete them so no future is left waiting
+	VisibilityRequests = MoveTemp(PendingVisibilityRequests);
+	CompleteVisibilityRequests();
+
+	Super::Deinitialize();
+}
+
+void UAdvancedSightSystem::GatherTargetSnapshots()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::GatherTargetSnapshots");
+
+	for (auto It = TargetSnapshots.CreateIterator(); It; ++It)
+	{
+		const TWeakObjectPtr<AActor>* TargetActor = TargetActors.Find(It.Key());
+		if (!TargetActor || !TargetActor->IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	for (const TTuple<uint32, TWeakObjectPtr<AActor>>& TargetActor : TargetActors)
+	{
+		const AActor* Actor = TargetActor.Value.Get();
+		if (!Actor)
+		{
+			continue;
+		}
+
+		FAdvancedSightTargetSnapshot& TargetSnapshot = TargetSnapshots.FindOrAdd(TargetActor.Key);
+		TargetSnapshot.Actor = Actor;
+		TargetSnapshot.Location = Actor->GetActorLocation();
+		TargetSnapshot.VisibilityPoints.Reset();
+		GetVisibilityPointsForActor(Actor, TargetSnapshot.VisibilityPoints);
+		if (TargetSnapshot.VisibilityPoints.Num() > FAdvancedSightQuery::MaxVisibilityPoints)
+		{
+			TargetSnapshot.VisibilityPoints.SetNum(FAdvancedSightQuery::MaxVisibilityPoints);
+		}
+	}
+}
+
+void UAdvancedSightSystem::GatherIllumination()
+{
+	Illumination.Reset();
+	for (const TWeakObjectPtr<const UAdvancedSightIlluminationGrid>& IlluminationGrid : IlluminationGrids)
+	{
+		if (const UAdvancedSightIlluminationGrid* Grid = IlluminationGrid.Get())
+		{
+			Illumination.Grids.Add(Grid);
+		}
+	}
+
+	for (const TWeakObjectPtr<const UAdvancedSightLightComponent>& Light : Lights)
+	{
+		const UAdvancedSightLightComponent* LightComponent = Light.Get();
+		if (LightComponent && LightComponent->IsLightEnabled() && LightComponent->Radius > 0.0f)
+		{
+			FAdvancedSightLightVolume& LightVolume = Illumination.LightVolumes.AddDefaulted_GetRef();
+			LightVolume.Location = LightComponent->GetComponentLocation();
+			LightVolume.RadiusSq = FMath::Square(LightComponent->Radius);
+			LightVolume.Illumination = LightComponent->Illumination;
+		}
+	}
+}
+
+void UAdvancedSightSystem::GatherActiveListeners(const int32 StaggerGroup)
+{
+	const int32 NumStaggerGroups = FMath::Max(GetDefault<UAdvancedSightSettings>()->NumStaggerGroups, 1);
+	for (TTuple<uint32, FAdvancedSightListenerQueries>& ListenerEntry : ListenerQueries)
+	{
+		if (DormantListeners.Contains(ListenerEntry.Key))
+		{
+			continue;
+		}
+
+		const UAdvancedSightComponent* SightComponent = Listeners.FindRef(ListenerEntry.Key).Get();
+		const AActor* BodyActor = SightComponent ? SightComponent->GetBodyActor() : nullptr;
+		if (!BodyActor)
+		{
+			continue;
+		}
+
+		FAdvancedSightListenerQueries& ListenerQueryRange = ListenerEntry.Value;
+		const int32 ActiveListenerIndex = ActiveListeners.AddDefaulted();
+		FAdvancedSightActiveListener& ActiveListener = ActiveListeners[ActiveListenerIndex];
+		ActiveListener.ListenerId = ListenerEntry.Key;
+		ActiveListener.SightComponent = SightComponent;
+		ActiveListener.BodyActor = BodyActor;
+		ActiveListener.BodyLocation = BodyActor->GetActorLocation();
+		SnapshotListenerEye(SightComponent, ActiveListener.Eye);
+		ActiveListener.Profile = &ListenerQueryRange.Profile;
+		ActiveListener.FirstQueryIndex = ListenerQueryRange.FirstQueryIndex;
+		ActiveListener.NumQueries = ListenerQueryRange.NumQueries;
+		ActiveListener.bIsInStaggerGroup =
+			StaggerGroup == INDEX_NONE || ListenerQueryRange.StaggerSlot % NumStaggerGroups == StaggerGroup;
+		if (ActiveListener.bIsInStaggerGroup)
+		{
+			ListenerQueryRange.EvaluatedEyeLocation = ActiveListener.Eye.Location;
+			ListenerQueryRange.EvaluatedEyeForward = ActiveListener.Eye.Forward;
+			ListenerQueryRange.bHasEvaluatedEye = true;
+		}
+	}
+}
+
+void UAdvancedSightSystem::BuildShards()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::BuildShards");
+
+	ShardGrid.Reset(GetDefault<UAdvancedSightSettings>()->ShardCellSize);
+	for (TTuple<uint32, FAdvancedSightTargetSnapshot>& TargetSnapshot : TargetSnapshots)
+	{
+		TargetSnapshot.Value.ShardCell = ShardGrid.GetCell(TargetSnapshot.Value.Location);
+		ShardGrid.AddTarget(TargetSnapshot.Value.ShardCell, TargetSnapshot.Key);
+	}
+
+	for (int32 Index = 0; Index < ActiveListeners.Num(); Index++)
+	{
+		ShardGrid.AddListener(ShardGrid.GetCell(ActiveListeners[Index].BodyLocation), Index);
+	}
+
+	ShardGrid.FinishBuild();
+}
+
+void UAdvancedSightSystem::GatherActiveQueries()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::GatherActiveQueries");
+
+	// Every shard only writes its own lists, which are concatenated afterwards so queries of a listener stay together
+	ParallelFor(ShardGrid.Num(), [this](int32 ShardIndex)
+	{
+		FAdvancedSightShard& Shard = ShardGrid.GetShard(ShardIndex);
+		for (const int32 ListenerIndex : Shard.ListenerIndices)
+		{
+			const FAdvancedSightActiveListener& ActiveListener = ActiveListeners[ListenerIndex];
+			const FAdvancedSightListenerQueries* ListenerEntry = ListenerQueries.Find(ActiveListener.ListenerId);
+			if (!ActiveListener.bIsInStaggerGroup || !ListenerEntry)
+			{
+				continue;
+			}
+
+			const int32 FirstShardQuery = Shard.QueryIndices.Num();
+			const float BroadphaseRadius = ActiveListener.Profile->BroadphaseRadius + BroadphaseMargin;
+			Shard.CandidateTargetIds.Reset();
+			ShardGrid.GatherTargetIds(ActiveListener.BodyLocation, BroadphaseRadius, Shard.CandidateTargetIds);
+			for (const uint32 TargetId : Shard.CandidateTargetIds)
+			{
+				const int32 QueryIndex =
+					FindListenerQueryIndex(ActiveListener.FirstQueryIndex, ActiveListener.NumQueries, TargetId);
+				if (QueryIndex != INDEX_NONE)
+				{
+					Shard.QueryIndices.Add(QueryIndex);
+				}
+			}
+
+			// Pairs with state are kept out of reach, so they fail the check and run down their gain and cooldown
+			FIntPoint MinCell;
+			FIntPoint MaxCell;
+			ShardGrid.GetCellRange(ActiveListener.BodyLocation, BroadphaseRadius, MinCell, MaxCell);
+			for (const uint32 TargetId : ListenerEntry->StatefulTargets)
+			{
+				const FAdvancedSightTargetSnapshot* TargetSnapshot = TargetSnapshots.Find(TargetId);
+				if (!TargetSnapshot
+					|| FAdvancedSightShardGrid::IsCellInRange(TargetSnapshot->ShardCell, MinCell, MaxCell))
+				{
+					continue;
+				}
+
+				const int32 QueryIndex =
+					FindListenerQueryIndex(ActiveListener.FirstQueryIndex, ActiveListener.NumQueries, TargetId);
+				if (QueryIndex != INDEX_NONE && Queries[QueryIndex].HasState())
+				{
+					Shard.QueryIndices.Add(QueryIndex);
+				}
+			}
+
+			// Back in memory order, the visibility pass walks the queries of the listener front to back
+			const int32 NumListenerQueries = Shard.QueryIndices.Num() - FirstShardQuery;
+			Algo::Sort(MakeArrayView(Shard.QueryIndices).Slice(FirstShardQuery, NumListenerQueries));
+			for (int32 Index = 0; Index < NumListenerQueries; Index++)
+			{
+				Shard.QueryListenerIndices.Add(ListenerIndex);
+			}
+		}
+	});
+
+	for (int32 ShardIndex = 0; ShardIndex < ShardGrid.Num(); ShardIndex++)
+	{
+		const FAdvancedSightShard& Shard = ShardGrid.GetShard(ShardIndex);
+		ActiveQueryIndices.Append(Shard.QueryIndices);
+		ActiveQueryListenerIndices.Append(Shard.QueryListenerIndices);
+	}
+}
+
+void UAdvancedSightSystem::ConditionalRebuildQueryLayout()
+{
+	if (!bIsQueryLayoutDirty)
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::ConditionalRebuildQueryLayout");
+
+	RemoveQueries([](const FAdvancedSightQuery& Query)
+	{
+		return Query.bIsRemoved;
+	});
+	bIsQueryLayoutDirty = false;
+	TArray<int32> Order;
+	Order.SetNumUninitialized(Queries.Num());
+	for (int32 Index = 0; Index < Order.Num(); Index++)
+	{
+		Order[Index] = Index;
+	}
+
+	Order.Sort([this](const int32 A, const int32 B)
+	{
+		const FAdvancedSightQuery& QueryA = Queries[A];
+		const FAdvancedSightQuery& QueryB = Queries[B];
+		return QueryA.ListenerId != QueryB.ListenerId
+			? QueryA.ListenerId < QueryB.ListenerId
+			: QueryA.TargetId < QueryB.TargetId;
+	});
+
+	TArray<FAdvancedSightQuery> SortedQueries;
+	TArray<FAdvancedSightQueryColdData> SortedQueriesColdData;
+	SortedQueries.Reserve(Queries.Num());
+	SortedQueriesColdData.Reserve(Queries.Num());
+	for (const int32 Index : Order)
+	{
+		SortedQueries.Add(Queries[Index]);
+		SortedQueriesColdData.Add(QueriesColdData[Index]);
+	}
+	Queries = MoveTemp(SortedQueries);
+	QueriesColdData = MoveTemp(SortedQueriesColdData);
+
+	for (TTuple<uint32, FAdvancedSightListenerQueries>& ListenerEntry : ListenerQueries)
+	{
+		ListenerEntry.Value.FirstQueryIndex = 0;
+		ListenerEntry.Value.NumQueries = 0;
+	}
+
+	FAdvancedSightListenerQueries* ListenerEntry = nullptr;
+	for (int32 Index = 0; Index < Queries.Num(); Index++)
+	{
+		if (Index == 0 || Queries[Index].ListenerId != Queries[Index - 1].ListenerId)
+		{
+			ListenerEntry = ListenerQueries.Find(Queries[Index].ListenerId);
+			if (ListenerEntry)
+			{
+				ListenerEntry->FirstQueryIndex = Index;
+			}
+		}
+
+		if (ListenerEntry)
+		{
+			ListenerEntry->NumQueries++;
+		}
+	}
+}
+
+void UAdvancedSightSystem::RemoveQueries(TFunctionRef<bool(const FAdvancedSightQuery& Query)> Predicate)
+{
+	// Keeps the order of the remaining queries, so they stay grouped by listener
+	int32 NumKeptQueries = 0;
+	for (int32 Index = 0; Index < Queries.Num(); Index++)
+	{
+		if (Predicate(Queries[Index]))
+		{
+			const FAdvancedSightQuery& Query = Queries[Index];
+			FAdvancedSightListenerQueries* ListenerEntry =
+				Query.HasState() ? ListenerQueries.Find(Query.ListenerId) : nullptr;
+			if (ListenerEntry)
+			{
+				ListenerEntry->StatefulTargets.Remove(Query.TargetId);
+			}
+			continue;
+		}
+
+		if (NumKeptQueries != Index)
+		{
+			Queries[NumKeptQueries] = Queries[Index];
+			QueriesColdData[NumKeptQueries] = QueriesColdData[Index];
+		}
+		NumKeptQueries++;
+	}
+
+	if (NumKeptQueries != Queries.Num())
+	{
+		Queries.SetNum(NumKeptQueries);
+		QueriesColdData.SetNum(NumKeptQueries);
+		bIsQueryLayoutDirty = true;
+	}
+}
+
+void UAdvancedSightSystem::TombstoneQueries(TFunctionRef<bool(const FAdvancedSightQuery& Query)> Predicate)
+{
+	for (FAdvancedSightQuery& Query : Queries)
+	{
+		if (!Query.bIsRemoved && Predicate(Query))
+		{
+			Query.bIsRemoved = true;
+			bIsQueryLayoutDirty = true;
+		}
+	}
+}
+
+void UAdvancedSightSystem::RemoveUnsubscribedQueries(TFunctionRef<bool(const FAdvancedSightQuery& Query)> Predicate)
+{
+	TArray<FAdvancedSightQuery> RemovedQueries;
+	RemoveQueries([&RemovedQueries, Predicate](const FAdvancedSightQuery& Query)
+	{
+		if (Query.bIsRemoved)
+		{
+			return true;
+		}
+
+		if (!Predicate(Query))
+		{
+			return false;
+		}
+
+		RemovedQueries.Add(Query);
+		return true;
+	});
+
+	// Delivered directly instead of as transitions, they do not come from the sight update and are not replayed
+	for (const FAdvancedSightQuery& Query : RemovedQueries)
+	{
+		if (Recorder.IsValid())
+		{
+			RecordedFrame.RemovedQueries.Add({ Query.ListenerId, Query.TargetId });
+		}
+
+		UAdvancedSightComponent* SightComponent = Listeners.FindRef(Query.ListenerId).Get();
+		AActor* TargetActor = TargetActors.FindRef(Query.TargetId).Get();
+		if (!SightComponent || !TargetActor)
+		{
+			continue;
+		}
+
+		if (Query.QuantizedGain != 0)
+		{
+			SightComponent->SetQuantizedGain(TargetActor, 0);
+		}
+
+		if (Query.bWasLastCheckSuccess)
+		{
+			SightComponent->LoseTarget(TargetActor);
+		}
+
+		if (Query.bIsTargetPerceived)
+		{
+			SightComponent->ForgetTarget(TargetActor);
+		}
 	}
 }
 
-void UAdvancedSightSystem::UnregisterListener(UAdvancedSightComponent* SightComponent)
+uint8 UAdvancedSightSystem::GetTargetCategories(const AActor* TargetActor)
 {
-	Queries.RemoveAllSwap([SightComponent](const FAdvancedSightQuery& Query)
-	{
-		return SightComponent->GetUniqueID() == Query.ListenerId;
-	});
+	const auto* TargetComponent = TargetActor->FindComponentByClass<UAdvancedSightTargetComponent>();
+	return TargetComponent
+		? static_cast<uint8>(TargetComponent->GetCategories())
+		: static_cast<uint8>(EAdvancedSightTargetCategory::Character);
 }
 
-void UAdvancedSightSystem::RegisterTarget(AActor* TargetActor)
+int32 UAdvancedSightSystem::FindQueryIndex(const uint32 ListenerId, const uint32 TargetId) const
 {
-	if (!TargetActor->Implements<UAdvancedSightTarget>())
+	const FAdvancedSightListenerQueries* ListenerEntry = ListenerQueries.Find(ListenerId);
+	if (!ListenerEntry)
 	{
-		return;
+		return INDEX_NONE;
 	}
 
-	TargetActors.Add(TargetActor->GetUniqueID(), TargetActor);
-	for (const TTuple<unsigned, TWeakObjectPtr<UAdvancedSightComponent>>& Listener : Listeners)
+	if (!bIsQueryLayoutDirty)
 	{
-		AddQuery(Listener.Value.Get(), TargetActor, Listener.Value->GetSightData());
+		return FindListenerQueryIndex(ListenerEntry->FirstQueryIndex, ListenerEntry->NumQueries, TargetId);
 	}
+
+	for (int32 Index = 0; Index < Queries.Num(); Index++)
+	{
+		const FAdvancedSightQuery& Query = Queries[Index];
+		if (Query.ListenerId == ListenerId && Query.TargetId == TargetId && !Query.bIsRemoved)
+		{
+			return Index;
+		}
+	}
+
+	return INDEX_NONE;
 }
 
-void UAdvancedSightSystem::UnregisterTarget(AActor* TargetActor)
+int32 UAdvancedSightSystem::FindListenerQueryIndex(
+	const int32 FirstQueryIndex, const int32 NumQueries, const uint32 TargetId) const
 {
-	Queries.RemoveAllSwap([TargetActor](const FAdvancedSightQuery& Query)
+	const TConstArrayView<FAdvancedSightQuery> ListenerSlice(Queries.GetData() + FirstQueryIndex, NumQueries);
+	const int32 Index = Algo::LowerBoundBy(ListenerSlice, TargetId, &FAdvancedSightQuery::TargetId);
+	if (Index < NumQueries && ListenerSlice[Index].TargetId == TargetId && !ListenerSlice[Index].bIsRemoved)
 	{
-		return TargetActor->GetUniqueID() == Query.TargetId;
-	});
+		return FirstQueryIndex + Index;
+	}
+
+	return INDEX_NONE;
 }
 
-float UAdvancedSightSystem::GetGainValueForTarget(const uint32 ListenerId, const uint32 TargetId) const
+void UAdvancedSightSystem::UpdateStatefulTarget(const FAdvancedSightQuery& Query)
 {
-	const FAdvancedSightQuery* Query = Queries.FindByPredicate([ListenerId, TargetId](const FAdvancedSightQuery& Query)
+	FAdvancedSightListenerQueries* ListenerEntry = ListenerQueries.Find(Query.ListenerId);
+	if (!ListenerEntry)
 	{
-		return Query.ListenerId == ListenerId && Query.TargetId == TargetId;
-	});
+		return;
+	}
 
-	if (!Query)
+	if (Query.HasState())
 	{
-		return -1.0f;
+		ListenerEntry->StatefulTargets.Add(Query.TargetId);
+	}
+	else
+	{
+		ListenerEntry->StatefulTargets.Remove(Query.TargetId);
 	}
-
-	return Query->GainValue;
 }
 
-FVector UAdvancedSightSystem::GetLastKnownLocationFor(const uint32 ListenerId, const uint32 TargetId) const
+void UAdvancedSightSystem::PrepareVisibilityRequests()
 {
-	const FAdvancedSightQuery* Query = Queries.FindByPredicate([ListenerId, TargetId](const FAdvancedSightQuery& Query)
+	VisibilityRequests = MoveTemp(PendingVisibilityRequests);
+	PendingVisibilityRequests.Reset();
+	for (FAdvancedSightVisibilityRequest& Request : VisibilityRequests)
 	{
-		return Query.ListenerId == ListenerId && Query.TargetId == TargetId;
-	});
+		const UAdvancedSightComponent* SightComponent = Request.SightComponent.Get();
+		UAdvancedSightData* SightData = Request.SightData.IsValid()
+			? Request.SightData.Get()
+			: (SightComponent ? SightComponent->GetSightData() : nullptr);
+		const AActor* TargetActor = Request.TargetActor.Get();
+		if (!SightComponent || !SightComponent->GetBodyActor() || !SightData || (Request.bHasTargetActor && !TargetActor))
+		{
+			continue;
+		}
 
-	if (!Query)
-	{
-		return FVector::ZeroVector;
-	}
+		SightData->ConditionalBakeCones();
+		Request.Profile.SetCones(SightData->GetCones());
+		Request.Profile.LoseSightRadius = SightData->LoseSightRadius;
+		Request.Profile.DarknessGainMultiplier = SightData->DarknessGainMultiplier;
+		Request.Profile.SetCategoryTuning(SightData->CategoryTuning);
+		if (TargetActor)
+		{
+			const uint8 Categories = GetTargetCategories(TargetActor) & SightComponent->GetSubscribedCategories();
+			Request.Query.CategoryIndex = FAdvancedSightListenerProfile::GetCategoryIndex(Categories);
+			if (const FAdvancedSightTargetSnapshot* TargetSnapshot = TargetSnapshots.Find(TargetActor->GetUniqueID()))
+			{
+				Request.VisibilityPoints = TargetSnapshot->VisibilityPoints;
+			}
+			else
+			{
+				GetVisibilityPointsForActor(TargetActor, Request.VisibilityPoints);
+				if (Request.VisibilityPoints.Num() > FAdvancedSightQuery::MaxVisibilityPoints)
+				{
+					Request.VisibilityPoints.SetNum(FAdvancedSightQuery::MaxVisibilityPoints);
+				}
+			}
+		}
+		else
+		{
+			Request.VisibilityPoints.Add(Request.TargetPoint);
+		}
 
-	return Query->LastSeenLocation;
+		Request.ResolvedSightComponent = SightComponent;
+		Request.ResolvedTargetActor = TargetActor;
+		SnapshotListenerEye(SightComponent, Request.Eye);
+	}
 }
 
-void UAdvancedSightSystem::PostInitProperties()
+void UAdvancedSightSystem::CompleteVisibilityRequests()
 {
-	Super::PostInitProperties();
-
-	if (!HasAnyFlags(RF_ClassDefaultObject))
+	for (FAdvancedSightVisibilityRequest& Request : VisibilityRequests)
 	{
-		const UWorld* World = GetWorld();
-		const FOnActorSpawned::FDelegate ActorSpawnedDelegate =
-			FOnActorSpawned::FDelegate::CreateUObject(this, &ThisClass::HandleNewActorSpawned);
-		NewActorSpawnedDelegateHandle = World->AddOnActorSpawnedHandler(ActorSpawnedDelegate);
+		FAdvancedSightVisibilityResult Result;
+		if (Request.ResolvedSightComponent)
+		{
+			Result.bIsVisible = Request.Query.bIsCurrentCheckSuccess;
+			Result.GainMultiplier = Result.bIsVisible ? Request.Query.CurrentGainMultiplier : 0.0f;
+			Result.VisibilityPointsFlags = Request.Query.bTargetVisibilityPointsFlag;
+		}
 
-		CVarShouldDebugDraw.AsVariable()->SetOnChangedCallback(
-			FConsoleVariableDelegate::CreateUObject(this, &ThisClass::OnDebugDrawStateChanged));
-		bShouldDebugDraw = CVarShouldDebugDraw.GetValueOnGameThread();
+		Request.OnCompleted(Result);
 	}
+
+	VisibilityRequests.Reset();
 }
 
-void UAdvancedSightSystem::Tick(float DeltaTime)
+void UAdvancedSightSystem::ApplyPerceptionSnapshot(FAdvancedSightPerceptionSnapshot& Snapshot)
 {
-	Super::Tick(DeltaTime);
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::ApplyPerceptionSnapshot");
 
-	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::Tick");
+	TMap<FString, int32> IdIndices;
+	IdIndices.Reserve(Snapshot.Ids.Num());
+	for (int32 Index = 0; Index < Snapshot.Ids.Num(); Index++)
+	{
+		IdIndices.Add(Snapshot.Ids[Index], Index);
+	}
 
-	const UWorld* World = GetWorld();
-	if (!World)
+	TArray<UAdvancedSightComponent*> ListenersById;
+	TArray<uint32> ListenerIdsById;
+	TArray<AActor*> TargetsById;
+	ListenersById.SetNumZeroed(Snapshot.Ids.Num());
+	ListenerIdsById.Init(UINT32_MAX, Snapshot.Ids.Num());
+	TargetsById.SetNumZeroed(Snapshot.Ids.Num());
+	for (const TTuple<uint32, TWeakObjectPtr<UAdvancedSightComponent>>& Listener : Listeners)
 	{
-		return;
+		UAdvancedSightComponent* SightComponent = Listener.Value.Get();
+		const AActor* BodyActor = SightComponent ? SightComponent->GetBodyActor() : nullptr;
+		if (const int32* IdIndex = BodyActor ? IdIndices.Find(GetPersistentId(BodyActor)) : nullptr)
+		{
+			ListenersById[*IdIndex] = SightComponent;
+			ListenerIdsById[*IdIndex] = Listener.Key;
+		}
 	}
 
-	const ECollisionChannel SightCollisionChannel = GetDefault<UAdvancedSightSettings>()->AdvancedSightCollisionChannel;
-	ParallelFor(Queries.Num(), [this, SightCollisionChannel](int32 Index)
+	for (const TTuple<uint32, TWeakObjectPtr<AActor>>& TargetActor : TargetActors)
 	{
-		FAdvancedSightQuery& Query = Queries[Index];
-		const UAdvancedSightComponent* SightComponent = Listeners[Query.ListenerId].Get();
-		const AActor* TargetActor = TargetActors[Query.TargetId].Get();
-		Query.bIsCurrentCheckSuccess = false;
-		ResetPointsVisibility(Query.bTargetVisibilityPointsFlag);
-		if (Query.bIsTargetPerceived)
+		AActor* Actor = TargetActor.Value.Get();
+		if (const int32* IdIndex = Actor ? IdIndices.Find(GetPersistentId(Actor)) : nullptr)
 		{
-			Query.bIsCurrentCheckSuccess = IsVisibleInsideCone(
-				SightComponent,
-				TargetActor,
-				Query.LoseSightRadius,
-				360.0f,
-				SightCollisionChannel,
-				Query.bTargetVisibilityPointsFlag);
+			TargetsById[*IdIndex] = Actor;
 		}
-		else
+	}
+
+	TMap<uint64, int32> QueryIndices;
+	QueryIndices.Reserve(Queries.Num());
+	for (int32 Index = 0; Index < Queries.Num(); Index++)
+	{
+		if (!Queries[Index].bIsRemoved)
 		{
-			for (const FAdvancedSightInfo& SightInfo : Query.SightInfos)
-			{
-				constexpr float EPSILON = 1.0f;
-				const float Radius =
-					Query.bWasLastCheckSuccess ? SightInfo.GainRadius + EPSILON : SightInfo.GainRadius;
-				const bool bIsVisibleInsideCone = IsVisibleInsideCone(
-					SightComponent,
-					TargetActor,
-					Radius,
-					SightInfo.FOV,
-					SightCollisionChannel,
-					Query.bTargetVisibilityPointsFlag);
-				if (bIsVisibleInsideCone)
-				{
-					Query.bIsCurrentCheckSuccess = true;
-					Query.CurrentGainMultiplier = SightInfo.GainMultiplier;
-					break;
-				}
-			}	
+			QueryIndices.Add((static_cast<uint64>(Queries[Index].ListenerId) << 32) | Queries[Index].TargetId, Index);
 		}
-	},
-	false);
+	}
 
-	for (FAdvancedSightQuery& Query : Queries)
+	Snapshot.Queries.RemoveAllSwap([this, &Snapshot, &ListenerIdsById, &TargetsById, &QueryIndices](
+		const FAdvancedSightPersistentQuery& PersistentQuery)
 	{
-		UAdvancedSightComponent* SightComponent = Listeners[Query.ListenerId].Get();
-		AActor* TargetActor = TargetActors[Query.TargetId].Get();
-		if (Query.bIsCurrentCheckSuccess)
+		if (!Snapshot.Ids.IsValidIndex(PersistentQuery.ListenerIndex)
+			|| !Snapshot.Ids.IsValidIndex(PersistentQuery.TargetIndex))
 		{
-			if (!Query.bWasLastCheckSuccess)
-			{
-				Query.bWasLastCheckSuccess = true;
-				SightComponent->SpotTarget(TargetActor);
-			}
+			return true;
+		}
 
-			Query.LastSeenLocation = TargetActor->GetActorLocation();
-			if (!Query.bIsTargetPerceived)
-			{
-				Query.GainValue += DeltaTime * Query.CurrentGainMultiplier;
-				if (Query.GainValue > 1.0f)
-				{
-					Query.bIsTargetPerceived = true;
-					SightComponent->PerceiveTarget(TargetActor);
-				}
-			}
-			else
-			{
-				Query.LoseSightTimer = 0.0f;
-			}
+		const uint32 ListenerId = ListenerIdsById[PersistentQuery.ListenerIndex];
+		const AActor* TargetActor = TargetsById[PersistentQuery.TargetIndex];
+		if (ListenerId == UINT32_MAX || !TargetActor)
+		{
+			return false;
 		}
-		else
+
+		const int32* QueryIndex = QueryIndices.Find((static_cast<uint64>(ListenerId) << 32) | TargetActor->GetUniqueID());
+		if (QueryIndex)
 		{
-			if (Query.bWasLastCheckSuccess)
-			{
-				Query.bWasLastCheckSuccess = false;
-				SightComponent->LoseTarget(TargetActor);
-			}
-			
+			FAdvancedSightQuery& Query = Queries[*QueryIndex];
+			Query.bWasLastCheckSuccess = (PersistentQuery.Flags & FAdvancedSightPersistentQuery::WasLastCheckSuccess) != 0;
+			Query.bIsTargetPerceived = (PersistentQuery.Flags & FAdvancedSightPersistentQuery::IsTargetPerceived) != 0;
+			Query.GainValue = PersistentQuery.GainValue;
+			Query.LoseSightTimer = PersistentQuery.LoseSightTimer;
+			QueriesColdData[*QueryIndex].LastSeenLocation = PersistentQuery.LastSeenLocation;
+			UpdateStatefulTarget(Query);
+		}
+
+		return true;
+	});
 
-			if (Query.bIsTargetPerceived)
+	Snapshot.Listeners.RemoveAllSwap([&Snapshot, &ListenersById, &TargetsById](
+		const FAdvancedSightPersistentListener& PersistentListener)
+	{
+		if (!Snapshot.Ids.IsValidIndex(PersistentListener.ListenerIndex))
+		{
+			return true;
+		}
+
+		UAdvancedSightComponent* SightComponent = ListenersById[PersistentListener.ListenerIndex];
+		if (!SightComponent)
+		{
+			return false;
+		}
+
+		// Restoring the membership replaces it as a whole, so it waits until every target it refers to is registered
+		for (const TArray<int32>* TargetIndices : { &PersistentListener.PerceivedTargets,
+			&PersistentListener.SpottedTargets, &PersistentListener.RememberedTargets })
+		{
+			for (const int32 TargetIndex : *TargetIndices)
 			{
-				Query.LoseSightTimer += DeltaTime;
-				if (Query.LoseSightTimer >= Query.LoseSightCooldown)
+				if (Snapshot.Ids.IsValidIndex(TargetIndex) && !TargetsById[TargetIndex])
 				{
-					Query.bIsTargetPerceived = false;
-					SightComponent->ForgetTarget(TargetActor);
+					return false;
 				}
 			}
-			else
+		}
+
+		auto ResolveTargets = [&Snapshot, &TargetsById](const TArray<int32>& TargetIndices)
+		{
+			TArray<AActor*> Targets;
+			Targets.Reserve(TargetIndices.Num());
+			for (const int32 TargetIndex : TargetIndices)
 			{
-				Query.GainValue -= DeltaTime;
-				if (Query.GainValue < 0.0f)
+				AActor* Target = Snapshot.Ids.IsValidIndex(TargetIndex) ? TargetsById[TargetIndex] : nullptr;
+				if (Target)
 				{
-					Query.GainValue = 0.0f;
+					Targets.Add(Target);
 				}
 			}
-		}
+			return Targets;
+		};
+		SightComponent->RestoreTargets(
+			ResolveTargets(PersistentListener.PerceivedTargets),
+			ResolveTargets(PersistentListener.SpottedTargets),
+			ResolveTargets(PersistentListener.RememberedTargets));
+		return true;
+	});
+
+	if (Snapshot.IsEmpty())
+	{
+		Snapshot.Reset();
 	}
+}
 
-	if (bShouldDebugDraw && DebugListener.IsValid())
+void UAdvancedSightSystem::DispatchSenseEvents()
+{
+	for (const FAdvancedSenseEvent& Event : SenseEvents)
 	{
-		DrawDebug(DebugListener.Get());
+		UAdvancedSightComponent* SightComponent = Listeners.FindRef(Event.ListenerId).Get();
+		if (!SightComponent)
+		{
+			continue;
+		}
+
+		FAdvancedSenseStimulus Stimulus;
+		Stimulus.SenseName = Event.SenseName;
+		Stimulus.SourceActor =
+			Event.TargetId != UINT32_MAX ? TargetActors.FindRef(Event.TargetId).Get() : Event.SourceActor.Get();
+		Stimulus.Location = Event.Location;
+		Stimulus.Strength = Event.Strength;
+		Stimulus.bIsActive = Event.bIsActive;
+		SightComponent->ReceiveStimulus(Stimulus);
 	}
+
+	SenseEvents.Reset();
 }
 
-TStatId UAdvancedSightSystem::GetStatId() const
+void UAdvancedSightSystem::RecordFrame(const float DeltaTime)
 {
-	RETURN_QUICK_DECLARE_CYCLE_STAT(UAdvancedSightSystem, STATGROUP_Tickables);
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UAdvancedSightSystem::RecordFrame");
+
+	RecordedFrame.DeltaTime = DeltaTime;
+	int32 LastRecordedListenerIndex = INDEX_NONE;
+	for (int32 Index = 0; Index < ActiveQueryIndices.Num(); Index++)
+	{
+		const FAdvancedSightQuery& Query = Queries[ActiveQueryIndices[Index]];
+		// Listeners unregistered by delegates of this update no longer have a profile to record
+		const FAdvancedSightListenerQueries* ListenerEntry = ListenerQueries.Find(Query.ListenerId);
+		if (Query.bIsRemoved || !ListenerEntry)
+		{
+			continue;
+		}
+
+		// Active queries of a listener are next to each other
+		if (ActiveQueryListenerIndices[Index] != LastRecordedListenerIndex)
+		{
+			LastRecordedListenerIndex = ActiveQueryListenerIndices[Index];
+			const FAdvancedSightActiveListener& ActiveListener = ActiveListeners[LastRecordedListenerIndex];
+			RecordedFrame.Listeners.Add({ Query.ListenerId, ActiveListener.Eye.Location, ActiveListener.Eye.Forward });
+			if (!Recorder->IsProfileRecorded(Query.ListenerId))
+			{
+				FAdvancedSightRecordedProfile& Profile = RecordedFrame.NewProfiles.AddDefaulted_GetRef();
+				static_cast<FAdvancedSightListenerProfile&>(Profile) = ListenerEntry->Profile;
+				Profile.ListenerId = Query.ListenerId;
+			}
+		}
+
+		RecordedFrame.Queries.Add(
+			{
+				Query.ListenerId,
+				Query.TargetId,
+				Query.TracedPointsMask,
+				Query.ClearPointsMask,
+				Query.Illumination,
+				Query.Transmittance,
+				Query.CategoryIndex
+			});
+	}
+
+	for (const TTuple<uint32, FAdvancedSightTargetSnapshot>& TargetSnapshot : TargetSnapshots)
+	{
+		FAdvancedSightRecordedTarget& Target = RecordedFrame.Targets.AddDefaulted_GetRef();
+		Target.TargetId = TargetSnapshot.Key;
+		Target.Location = TargetSnapshot.Value.Location;
+		Target.VisibilityPoints = TargetSnapshot.Value.VisibilityPoints;
+	}
+
+	Recorder->WriteFrame(RecordedFrame);
+	RecordedFrame.Reset();
 }
 
-void UAdvancedSightSystem::HandleNewActorSpawned(AActor* Actor)
+void UAdvancedSightSystem::SnapshotListenerEye(
+	const UAdvancedSightComponent* SightComponent, FAdvancedSightListenerEye& OutEye)
 {
-	RegisterTarget(Actor);
+	const FTransform EyeTransform = SightComponent->GetEyePointOfViewTransform();
+	OutEye.Location = EyeTransform.GetLocation();
+	OutEye.Forward = EyeTransform.GetRotation().Vector();
+	OutEye.QueryParams = FCollisionQueryParams(SCENE_QUERY_STAT(AdvancedSight), false);
+	SightComponent->AddIgnoredActors(OutEye.QueryParams);
 }
 
-void UAdvancedSightSystem::AddQuery(
-	const UAdvancedSightComponent* SightComponent, const AActor* TargetActor, const UAdvancedSightData* SightData)
+void UAdvancedSightSystem::GetEvaluatedEye(
+	const UAdvancedSightComponent* SightComponent, FVector& OutLocation, FVector& OutForward) const
 {
-	if (!SightData)
+	const FAdvancedSightListenerQueries* ListenerEntry = ListenerQueries.Find(SightComponent->GetUniqueID());
+	if (ListenerEntry && ListenerEntry->bHasEvaluatedEye)
 	{
+		OutLocation = ListenerEntry->EvaluatedEyeLocation;
+		OutForward = ListenerEntry->EvaluatedEyeForward;
 		return;
 	}
-	
-	if (SightComponent->GetOwner() == TargetActor)
+
+	// Not evaluated yet, e.g. registered while dormant
+	const FTransform EyeTransform = SightComponent->GetEyePointOfViewTransform();
+	OutLocation = EyeTransform.GetLocation();
+	OutForward = EyeTransform.GetRotation().Vector();
+}
+
+void UAdvancedSightSystem::EvaluateVisibility(
+	FAdvancedSightQuery& Query,
+	const FAdvancedSightListenerProfile& Profile,
+	const FAdvancedSightListenerEye& Eye,
+	TConstArrayView<FVector> VisibilityPoints,
+	const AActor* TargetActor,
+	const FAdvancedSightWorldContext& WorldContext)
+{
+	const FVector& EyeLocation = Eye.Location;
+	const FCollisionQueryParams& QueryParams = Eye.QueryParams;
+	TArray<int32, TInlineAllocator<4>> EyeCellIndices;
+	for (const FAdvancedSightVisibilitySet* VisibilitySet : WorldContext.VisibilitySets)
 	{
-		return;
+		EyeCellIndices.Add(VisibilitySet->GetCellIndex(EyeLocation));
 	}
 
-	if (SightComponent->GetBodyActor()->Implements<UGenericTeamAgentInterface>()
-		&& TargetActor->Implements<UGenericTeamAgentInterface>())
-	{
-		const auto* ListenerTeamAgent = Cast<IGenericTeamAgentInterface>(SightComponent->GetBodyActor());
-		const auto* TargetTeamAgent = Cast<IGenericTeamAgentInterface>(TargetActor);
-		const bool bShouldSense = FAISenseAffiliationFilter::ShouldSenseTeam(
-			ListenerTeamAgent->GetGenericTeamId(),
-			TargetTeamAgent->GetGenericTeamId(),
-			SightData->DetectionByAffiliation.GetAsFlags());
-		if (!bShouldSense)
+	EvaluateQueryVisibility(
+		Query,
+		Profile,
+		EyeLocation,
+		Eye.Forward,
+		VisibilityPoints,
+		[&WorldContext, &QueryParams, &EyeLocation, VisibilityPoints, TargetActor, &EyeCellIndices](int32 PointIndex)
 		{
-			return;
-		}
-	}
+			// Pairs the static geometry always separates never reach the physics scene
+			const TConstArrayView<const FAdvancedSightVisibilitySet*> VisibilitySets = WorldContext.VisibilitySets;
+			for (int32 SetIndex = 0; SetIndex < VisibilitySets.Num(); SetIndex++)
+			{
+				const int32 PointCellIndex = VisibilitySets[SetIndex]->GetCellIndex(VisibilityPoints[PointIndex]);
+				if (!VisibilitySets[SetIndex]->IsPotentiallyVisible(EyeCellIndices[SetIndex], PointCellIndex))
+				{
+					return 0.0f;
+				}
+			}
 
-	FAdvancedSightQuery& Query = Queries.AddDefaulted_GetRef();
-	Query.ListenerId = SightComponent->GetUniqueID();
-	Query.TargetId = TargetActor->GetUniqueID();
-	TArray<FAdvancedSightInfo> SortedSightInfos = SightData->SightInfos;
-	SortedSightInfos.Sort([](const FAdvancedSightInfo& Lhs, const FAdvancedSightInfo& Rhs)
-	{
-		return Lhs.GainRadius < Rhs.GainRadius;
-	});
-	Query.SightInfos = MoveTemp(SortedSightInfos);
-	Query.LoseSightRadius = SightData->LoseSightRadius;
-	Query.LoseSightCooldown = SightData->LoseSightCooldown;
+			if (WorldContext.TransmittanceTable)
+			{
+				return TraceTransmittance(WorldContext, QueryParams, EyeLocation, VisibilityPoints[PointIndex], TargetActor);
+			}
+
+			FHitResult HitResult;
+			const bool bHit = WorldContext.World->LineTraceSingleByChannel(
+				HitResult, EyeLocation, VisibilityPoints[PointIndex], WorldContext.CollisionChannel, QueryParams);
+			return (!bHit || (TargetActor && HitResult.GetActor() == TargetActor)) ? 1.0f : 0.0f;
+		},
+		[&WorldContext, VisibilityPoints](int32 PointIndex)
+		{
+			return WorldContext.Illumination->Sample(VisibilityPoints[PointIndex]);
+		});
 }
 
-bool UAdvancedSightSystem::IsVisibleInsideCone(
-	const UAdvancedSightComponent* SourceComponent,
-	const AActor* TargetActor,
-	const float Radius,
-	const float FOV,
-	ECollisionChannel CollisionChannel,
-	int32& VisibilityPointsFlags)
-{
-	const float CheckRadiusSq = FMath::Square(Radius);
-	const FTransform SourceTransform = SourceComponent->GetEyePointOfViewTransform();
-	const FVector SourceForward = SourceTransform.GetRotation().Vector();
-	TArray<FVector> VisibilityPoints;
-	GetVisibilityPointsForActor(TargetActor, VisibilityPoints);
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActor(SourceComponent->GetBodyActor());
-	for (int32 Index = 0; Index < VisibilityPoints.Num(); Index++)
-	{
-		const float DistanceSq = FVector::DistSquared(SourceTransform.GetLocation(), VisibilityPoints[Index]);
-		if (DistanceSq > CheckRadiusSq)
+float UAdvancedSightSystem::TraceTransmittance(
+	const FAdvancedSightWorldContext& WorldContext,
+	const FCollisionQueryParams& QueryParams,
+	const FVector& Start,
+	const FVector& End,
+	const AActor* TargetActor)
+{
+	// Touching hits come sorted by distance followed by the blocking hit. A blocking hit with a transmittance is
+	// ignored and the trace continues from it, so every ray costs one trace per partially transparent blocking hit.
+	FCollisionQueryParams RayQueryParams = QueryParams;
+	RayQueryParams.bReturnPhysicalMaterial = !WorldContext.TransmittanceTable->Materials.IsEmpty();
+	TArray<FHitResult> Hits;
+	FVector TraceStart = Start;
+	float Transmittance = 1.0f;
+	int32 NumOcclusionHits = 0;
+	while (true)
+	{
+		Hits.Reset();
+		WorldContext.World->LineTraceMultiByChannel(Hits, TraceStart, End, WorldContext.CollisionChannel, RayQueryParams);
+		const FHitResult* BlockingHit = nullptr;
+		for (const FHitResult& Hit : Hits)
 		{
-			continue;
+			if (TargetActor && Hit.GetActor() == TargetActor)
+			{
+				return Transmittance;
+			}
+
+			float HitTransmittance = 1.0f;
+			if (!WorldContext.TransmittanceTable->TryFind(Hit, HitTransmittance))
+			{
+				if (Hit.bBlockingHit)
+				{
+					return 0.0f;
+				}
+
+				continue;
+			}
+
+			Transmittance *= HitTransmittance;
+			NumOcclusionHits++;
+			if (Transmittance < WorldContext.MinTransmittance || NumOcclusionHits > WorldContext.MaxOcclusionHits)
+			{
+				return 0.0f;
+			}
+
+			if (Hit.bBlockingHit)
+			{
+				BlockingHit = &Hit;
+			}
 		}
 
-		const FVector DirectionToTarget = (VisibilityPoints[Index] - SourceTransform.GetLocation()).GetSafeNormal();
-		const float DotProduct = FVector::DotProduct(DirectionToTarget, SourceForward);
-		const float Angle = FMath::Acos(DotProduct);
-		const float MaxAngle = FMath::DegreesToRadians(FOV / 2.0f);
-		if (Angle > MaxAngle)
+		if (!BlockingHit)
 		{
-			continue;
+			return Transmittance;
 		}
 
-		FHitResult HitResult;
-		const UWorld* World = TargetActor->GetWorld();
-		check(World);
-		const bool bHit = World->LineTraceSingleByChannel(
-			HitResult,
-			SourceTransform.GetLocation(),
-			VisibilityPoints[Index],
-			CollisionChannel,
-			QueryParams);
-		if (bHit && HitResult.GetActor() != TargetActor)
+		RayQueryParams.AddIgnoredComponent(BlockingHit->GetComponent());
+		TraceStart = BlockingHit->Location;
+	}
+}
+
+int32 UAdvancedSightSystem::FindVisiblePoint(
+	FAdvancedSightQuery& Query, uint32 PointsMask, FLineOfSightFunction LineOfSightFunction)
+{
+	while (PointsMask != 0)
+	{
+		const int32 Index = FMath::CountTrailingZeros(PointsMask);
+		PointsMask &= PointsMask - 1;
+		if (HasLineOfSight(Query, Index, LineOfSightFunction))
 		{
-			continue;
+			SetPointVisible(Query.bTargetVisibilityPointsFlag, Index, true);
+			return Index;
 		}
+	}
 
-		SetPointVisible(VisibilityPointsFlags, Index, true);
-		return true;
+	return INDEX_NONE;
+}
+
+bool UAdvancedSightSystem::HasLineOfSight(
+	FAdvancedSightQuery& Query, const int32 PointIndex, FLineOfSightFunction LineOfSightFunction)
+{
+	const uint32 PointBit = 1u << PointIndex;
+	if (!(Query.TracedPointsMask & PointBit))
+	{
+		Query.TracedPointsMask |= PointBit;
+		const float Transmittance = LineOfSightFunction(PointIndex);
+		if (Transmittance > 0.0f)
+		{
+			// Cones stop at the first clear point, so the last clear trace is the one the gain is scaled by
+			Query.ClearPointsMask |= PointBit;
+			Query.Transmittance = FAdvancedSightTransmittanceTable::Quantize(Transmittance);
+		}
 	}
 
-	return false;
+	return (Query.ClearPointsMask & PointBit) != 0;
 }
 
 void UAdvancedSightSystem::SetPointVisible(int32& Flags, int32 PointIndex, bool bIsVisible)
@@ -405,10 +2226,20 @@ void UAdvancedSightSystem::DrawDebug(const UAdvancedSightComponent* SightCompone
 	}
 
 	const UWorld* World = GetWorld();
-	const FVector CenterLocation = SightComponent->GetBodyActor()->GetActorLocation();
-	const FVector ForwardVector = SightComponent->GetBodyActor()->GetActorForwardVector();
+	FVector CenterLocation;
+	FVector ForwardVector;
+	GetEvaluatedEye(SightComponent, CenterLocation, ForwardVector);
 	for (const FAdvancedSightInfo& SightInfo : SightData->SightInfos)
 	{
+		if (SightInfo.Shape == EAdvancedSightConeShape::Box)
+		{
+			const float HalfDepth = SightInfo.GainRadius / 2.0f;
+			const FVector Extent(HalfDepth, SightInfo.BoxHalfSize.X, SightInfo.BoxHalfSize.Y);
+			const FVector BoxCenter = CenterLocation + ForwardVector * HalfDepth;
+			DrawDebugBox(World, BoxCenter, Extent, ForwardVector.ToOrientationQuat(), SightInfo.DebugColor);
+			continue;
+		}
+
 		const FVector LeftForward = ForwardVector.RotateAngleAxis(-SightInfo.FOV / 2.0f, FVector::UpVector);
 		const FVector RightForward = ForwardVector.RotateAngleAxis(SightInfo.FOV / 2.0f, FVector::UpVector);
 		const FVector LeftCenterCorner = CenterLocation + LeftForward * SightInfo.GainRadius;
@@ -437,15 +2268,14 @@ void UAdvancedSightSystem::DrawDebug(const UAdvancedSightComponent* SightCompone
 
 		const uint32 ListenerId = SightComponent->GetUniqueID();
 		const uint32 TargetId = PerceivedTarget->GetUniqueID();
-		const FAdvancedSightQuery* Query = Queries.FindByPredicate([ListenerId, TargetId](const FAdvancedSightQuery& Query)
-		{
-			return Query.ListenerId == ListenerId && Query.TargetId == TargetId;
-		});
-		if (!ensure(Query))
+		const int32 QueryIndex = FindQueryIndex(ListenerId, TargetId);
+		if (!ensure(QueryIndex != INDEX_NONE))
 		{
 			continue;
 		}
 
+		const FAdvancedSightQuery* Query = &Queries[QueryIndex];
+
 		for (int32 Index = 0; Index < VisibilityPoints.Num(); Index++)
 		{
 			const bool bIsPointVisible = IsPointVisible(Query->bTargetVisibilityPointsFlag, Index);
@@ -480,14 +2310,13 @@ void UAdvancedSightSystem::DrawDebug(const UAdvancedSightComponent* SightCompone
 		GetVisibilityPointsForActor(SpottedTarget, VisibilityPoints);
 		const uint32 ListenerId = SightComponent->GetUniqueID();
 		const uint32 TargetId = SpottedTarget->GetUniqueID();
-		const FAdvancedSightQuery* Query = Queries.FindByPredicate([ListenerId, TargetId](const FAdvancedSightQuery& Query)
-		{
-			return Query.ListenerId == ListenerId && Query.TargetId == TargetId;
-		});
-		if (!ensure(Query))
+		const int32 QueryIndex = FindQueryIndex(ListenerId, TargetId);
+		if (!ensure(QueryIndex != INDEX_NONE))
 		{
 			continue;
 		}
+
+		const FAdvancedSightQuery* Query = &Queries[QueryIndex];
 		
 		for (int32 Index = 0; Index < VisibilityPoints.Num(); Index++)
 		{
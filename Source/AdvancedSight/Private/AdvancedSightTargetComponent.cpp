@@ -3,6 +3,7 @@
 
 #include "AdvancedSightTargetComponent.h"
 
+#include "AdvancedSightSystem.h"
 #include "AdvancedSightTarget.h"
 
 UAdvancedSightTargetComponent::UAdvancedSightTargetComponent()
@@ -24,6 +25,26 @@ void UAdvancedSightTargetComponent::GetVisibilityPoints(TArray<FVector>& Visibil
 	}
 }
 
+void UAdvancedSightTargetComponent::SetCategories(int32 InCategories)
+{
+	if (Categories == InCategories)
+	{
+		return;
+	}
+
+	Categories = InCategories;
+	UAdvancedSightSystem* AdvancedSightSystem = GetWorld()->GetSubsystem<UAdvancedSightSystem>();
+	if (AdvancedSightSystem && GetOwnerRole() == ROLE_Authority)
+	{
+		AdvancedSightSystem->UpdateTargetCategories(GetOwner());
+	}
+}
+
+int32 UAdvancedSightTargetComponent::GetCategories() const
+{
+	return Categories;
+}
+
 void UAdvancedSightTargetComponent::BeginPlay()
 {
 	Super::BeginPlay();
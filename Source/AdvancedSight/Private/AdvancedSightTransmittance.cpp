@@ -0,0 +1,40 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightTransmittance.h"
+
+#include "Components/PrimitiveComponent.h"
+#include "Engine/HitResult.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+
+void FAdvancedSightTransmittanceTable::Reset()
+{
+	Materials.Reset();
+	Components.Reset();
+}
+
+bool FAdvancedSightTransmittanceTable::TryFind(const FHitResult& Hit, float& OutTransmittance) const
+{
+	if (const float* ComponentTransmittance = Components.Find(Hit.GetComponent()))
+	{
+		OutTransmittance = *ComponentTransmittance;
+		return true;
+	}
+
+	if (const float* MaterialTransmittance = Materials.Find(Hit.PhysMaterial.Get()))
+	{
+		OutTransmittance = *MaterialTransmittance;
+		return true;
+	}
+
+	return false;
+}
+
+uint8 FAdvancedSightTransmittanceTable::Quantize(const float Transmittance)
+{
+	return static_cast<uint8>(FMath::RoundToInt(FMath::Clamp(Transmittance, 0.0f, 1.0f) * 255.0f));
+}
+
+float FAdvancedSightTransmittanceTable::Dequantize(const uint8 QuantizedTransmittance)
+{
+	return QuantizedTransmittance / 255.0f;
+}
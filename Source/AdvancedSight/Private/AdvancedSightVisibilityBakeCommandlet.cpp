@@ -0,0 +1,169 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightVisibilityBakeCommandlet.h"
+
+#include "AdvancedSightBakeUtils.h"
+#include "AdvancedSightCommon.h"
+#include "AdvancedSightSettings.h"
+#include "AdvancedSightVisibilitySet.h"
+#include "AdvancedSightVisibilityVolume.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+namespace AdvancedSightVisibilityBake
+{
+	// Cell corners are pulled towards the center so rays do not graze the geometry the cell is resting on
+	static constexpr float CornerInset = 0.25f;
+
+	static void GetSamplePoints(const FAdvancedSightGridLayout& Layout, const int32 CellIndex, FVector OutPoints[9])
+	{
+		const FVector Center = Layout.GetCellCenter(CellIndex);
+		const float Offset = Layout.CellSize * (0.5f - CornerInset);
+		OutPoints[0] = Center;
+		for (int32 Corner = 0; Corner < 8; Corner++)
+		{
+			OutPoints[Corner + 1] = Center + FVector(
+				Corner & 1 ? Offset : -Offset, Corner & 2 ? Offset : -Offset, Corner & 4 ? Offset : -Offset);
+		}
+	}
+
+	static bool AreNeighbours(const FAdvancedSightGridLayout& Layout, const int32 CellA, const int32 CellB)
+	{
+		const FVector Distance = (Layout.GetCellCenter(CellA) - Layout.GetCellCenter(CellB)).GetAbs();
+		return Distance.GetMax() <= Layout.CellSize * 1.5f;
+	}
+}
+
+UAdvancedSightVisibilityBakeCommandlet::UAdvancedSightVisibilityBakeCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UAdvancedSightVisibilityBakeCommandlet::Main(const FString& Params)
+{
+	FString MapPackageName;
+	if (!FParse::Value(*Params, TEXT("Map="), MapPackageName))
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Missing -Map=<map package name> argument"));
+		return 1;
+	}
+
+	UWorld* World = AdvancedSightBake::LoadWorld(MapPackageName);
+	if (!World)
+	{
+		return 1;
+	}
+
+	int32 Result = 0;
+	TActorIterator<AAdvancedSightVisibilityVolume> It(World);
+	if (!It)
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Map %s has no visibility volume"), *MapPackageName);
+		Result = 1;
+	}
+	else
+	{
+		const FString FilePath = FAdvancedSightVisibilitySet::GetFilePathForLevel(MapPackageName);
+		if (!BakeVolume(World, *It, FilePath))
+		{
+			UE_LOG(LogAdvancedSight, Error, TEXT("Failed to write visibility set %s"), *FilePath);
+			Result = 1;
+		}
+
+		if (++It)
+		{
+			UE_LOG(LogAdvancedSight, Warning, TEXT("Only the first visibility volume of %s was baked"), *MapPackageName);
+		}
+	}
+
+	AdvancedSightBake::ReleaseWorld(World);
+	return Result;
+}
+
+bool UAdvancedSightVisibilityBakeCommandlet::BakeVolume(
+	const UWorld* World, const AAdvancedSightVisibilityVolume* Volume, const FString& FilePath)
+{
+	using namespace AdvancedSightVisibilityBake;
+
+	const FAdvancedSightGridLayout Layout =
+		FAdvancedSightGridLayout::MakeFromBounds(Volume->GetComponentsBoundingBox(true), Volume->CellSize);
+	const int32 NumCells = Layout.GetNumCells();
+	if (NumCells == 0)
+	{
+		return false;
+	}
+
+	const ECollisionChannel SightCollisionChannel = GetDefault<UAdvancedSightSettings>()->AdvancedSightCollisionChannel;
+	const float MaxDistanceSq = FMath::Square(Volume->MaxDistance + Layout.CellSize * UE_SQRT_3);
+	TArray<TBitArray<>> CellVisibility;
+	CellVisibility.SetNum(NumCells);
+	for (TBitArray<>& CellRow : CellVisibility)
+	{
+		CellRow.Init(false, NumCells);
+	}
+
+	// Every pair is evaluated once by its lower cell and mirrored afterwards, so rows are only written by their own task
+	ParallelFor(NumCells, [World, &Layout, &CellVisibility, SightCollisionChannel, MaxDistanceSq, NumCells](int32 CellA)
+	{
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(AdvancedSightVisibilityBake));
+		QueryParams.MobilityType = EQueryMobilityType::Static;
+		FVector PointsA[9];
+		FVector PointsB[9];
+		GetSamplePoints(Layout, CellA, PointsA);
+		CellVisibility[CellA][CellA] = true;
+		for (int32 CellB = CellA + 1; CellB < NumCells; CellB++)
+		{
+			if (FVector::DistSquared(PointsA[0], Layout.GetCellCenter(CellB)) > MaxDistanceSq)
+			{
+				continue;
+			}
+
+			if (AreNeighbours(Layout, CellA, CellB))
+			{
+				CellVisibility[CellA][CellB] = true;
+				continue;
+			}
+
+			GetSamplePoints(Layout, CellB, PointsB);
+			bool bIsVisible = false;
+			for (int32 IndexA = 0; IndexA < 9 && !bIsVisible; IndexA++)
+			{
+				for (int32 IndexB = 0; IndexB < 9 && !bIsVisible; IndexB++)
+				{
+					bIsVisible = !World->LineTraceTestByChannel(
+						PointsA[IndexA], PointsB[IndexB], SightCollisionChannel, QueryParams);
+				}
+			}
+
+			CellVisibility[CellA][CellB] = bIsVisible;
+		}
+	});
+
+	int32 NumVisiblePairs = 0;
+	for (int32 CellA = 0; CellA < NumCells; CellA++)
+	{
+		for (TConstSetBitIterator<> It(CellVisibility[CellA], CellA + 1); It; ++It)
+		{
+			CellVisibility[It.GetIndex()][CellA] = true;
+			NumVisiblePairs++;
+		}
+	}
+
+	if (!FAdvancedSightVisibilitySet::Write(FilePath, Layout, CellVisibility))
+	{
+		return false;
+	}
+
+	UE_LOG(
+		LogAdvancedSight,
+		Display,
+		TEXT("Baked %d cells with %d potentially visible pairs into %s"),
+		NumCells,
+		NumVisiblePairs,
+		*FilePath);
+	return true;
+}
@@ -0,0 +1,187 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightVisibilitySet.h"
+
+#include "AdvancedSightCommon.h"
+#include "Async/MappedFileHandle.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+
+namespace AdvancedSightVisibilitySet
+{
+	static constexpr uint32 Magic = 0x56505341; // "ASPV"
+	static constexpr uint32 Version = 1;
+}
+
+FAdvancedSightVisibilitySet::~FAdvancedSightVisibilitySet()
+{
+	Close();
+}
+
+FString FAdvancedSightVisibilitySet::GetFilePathForLevel(const FString& LevelPackageName)
+{
+	const FString ShortName = FPackageName::GetShortName(UWorld::RemovePIEPrefix(LevelPackageName));
+	return FPaths::ProjectContentDir() / TEXT("AdvancedSight") / ShortName + TEXT(".aspvs");
+}
+
+bool FAdvancedSightVisibilitySet::Write(
+	const FString& FilePath, const FAdvancedSightGridLayout& Layout, const TArray<TBitArray<>>& CellVisibility)
+{
+	const int32 NumCells = Layout.GetNumCells();
+	if (!ensure(CellVisibility.Num() == NumCells))
+	{
+		return false;
+	}
+
+	int32 WordsPerRow = FMath::DivideAndRoundUp(NumCells, 32);
+	TArray<uint32> RowIndices;
+	TArray<uint32> Rows;
+	TArray<uint32> RowWords;
+	TMultiMap<uint32, int32> RowsByHash;
+	RowIndices.Reserve(NumCells);
+	for (const TBitArray<>& CellRow : CellVisibility)
+	{
+		RowWords.Reset();
+		RowWords.SetNumZeroed(WordsPerRow);
+		for (TConstSetBitIterator<> It(CellRow); It; ++It)
+		{
+			RowWords[It.GetIndex() / 32] |= 1u << (It.GetIndex() % 32);
+		}
+
+		const uint32 RowHash = FCrc::MemCrc32(RowWords.GetData(), WordsPerRow * sizeof(uint32));
+		int32 RowIndex = INDEX_NONE;
+		for (TMultiMap<uint32, int32>::TConstKeyIterator It(RowsByHash, RowHash); It; ++It)
+		{
+			if (FMemory::Memcmp(&Rows[It.Value() * WordsPerRow], RowWords.GetData(), WordsPerRow * sizeof(uint32)) == 0)
+			{
+				RowIndex = It.Value();
+				break;
+			}
+		}
+
+		if (RowIndex == INDEX_NONE)
+		{
+			RowIndex = Rows.Num() / WordsPerRow;
+			Rows.Append(RowWords);
+			RowsByHash.Add(RowHash, RowIndex);
+		}
+
+		RowIndices.Add(RowIndex);
+	}
+
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*FilePath));
+	if (!Writer.IsValid())
+	{
+		return false;
+	}
+
+	uint32 Magic = AdvancedSightVisibilitySet::Magic;
+	uint32 Version = AdvancedSightVisibilitySet::Version;
+	FAdvancedSightGridLayout LayoutCopy = Layout;
+	int32 NumUniqueRows = Rows.Num() / FMath::Max(WordsPerRow, 1);
+	*Writer << Magic;
+	*Writer << Version;
+	*Writer << LayoutCopy;
+	*Writer << NumUniqueRows;
+	*Writer << WordsPerRow;
+	Writer->Serialize(RowIndices.GetData(), RowIndices.Num() * sizeof(uint32));
+	Writer->Serialize(Rows.GetData(), Rows.Num() * sizeof(uint32));
+	return Writer->Close();
+}
+
+bool FAdvancedSightVisibilitySet::Open(const FString& FilePath)
+{
+	Close();
+
+	MappedFileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath));
+	if (!MappedFileHandle.IsValid())
+	{
+		return false;
+	}
+
+	MappedFileRegion.Reset(MappedFileHandle->MapRegion(0, MappedFileHandle->GetFileSize()));
+	if (!MappedFileRegion.IsValid())
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Failed to map visibility set %s"), *FilePath);
+		Close();
+		return false;
+	}
+
+	const TArrayView<const uint8> MappedData = MakeArrayView(
+		MappedFileRegion->GetMappedPtr(), static_cast<int32>(MappedFileRegion->GetMappedSize()));
+	FMemoryReaderView Reader(MappedData);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	Reader << Magic;
+	Reader << Version;
+	if (Magic != AdvancedSightVisibilitySet::Magic || Version != AdvancedSightVisibilitySet::Version)
+	{
+		UE_LOG(
+			LogAdvancedSight,
+			Error,
+			TEXT("%s is not a visibility set of version %u"),
+			*FilePath,
+			AdvancedSightVisibilitySet::Version);
+		Close();
+		return false;
+	}
+
+	Reader << Layout;
+	Reader << NumUniqueRows;
+	Reader << WordsPerRow;
+	const int64 NumCells = Layout.GetNumCells();
+	const int64 NumWords = NumCells + static_cast<int64>(NumUniqueRows) * WordsPerRow;
+	const int64 ExpectedSize = Reader.Tell() + NumWords * sizeof(uint32);
+	if (Reader.IsError() || NumCells == 0 || WordsPerRow != FMath::DivideAndRoundUp<int64>(NumCells, 32)
+		|| MappedData.Num() < ExpectedSize)
+	{
+		UE_LOG(LogAdvancedSight, Error, TEXT("Visibility set %s is corrupted"), *FilePath);
+		Close();
+		return false;
+	}
+
+	RowIndices = reinterpret_cast<const uint32*>(MappedData.GetData() + Reader.Tell());
+	Rows = RowIndices + NumCells;
+	return true;
+}
+
+void FAdvancedSightVisibilitySet::Close()
+{
+	RowIndices = nullptr;
+	Rows = nullptr;
+	NumUniqueRows = 0;
+	WordsPerRow = 0;
+	Layout = FAdvancedSightGridLayout();
+	MappedFileRegion.Reset();
+	MappedFileHandle.Reset();
+}
+
+const FAdvancedSightGridLayout& FAdvancedSightVisibilitySet::GetLayout() const
+{
+	return Layout;
+}
+
+int32 FAdvancedSightVisibilitySet::GetNumUniqueRows() const
+{
+	return NumUniqueRows;
+}
+
+int32 FAdvancedSightVisibilitySet::GetCellIndex(const FVector& Location) const
+{
+	return Rows ? Layout.GetCellIndex(Location) : INDEX_NONE;
+}
+
+bool FAdvancedSightVisibilitySet::IsPotentiallyVisible(const int32 FromCellIndex, const int32 ToCellIndex) const
+{
+	if (FromCellIndex == INDEX_NONE || ToCellIndex == INDEX_NONE)
+	{
+		return true;
+	}
+
+	const uint32* Row = Rows + static_cast<int64>(RowIndices[FromCellIndex]) * WordsPerRow;
+	return (Row[ToCellIndex / 32] >> (ToCellIndex % 32)) & 1;
+}
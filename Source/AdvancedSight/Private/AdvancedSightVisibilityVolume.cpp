@@ -0,0 +1,33 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightVisibilityVolume.h"
+
+#include "AdvancedSightSystem.h"
+#include "Components/BrushComponent.h"
+
+AAdvancedSightVisibilityVolume::AAdvancedSightVisibilityVolume()
+{
+	GetBrushComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	bColored = true;
+	BrushColor = FColor(40, 200, 255);
+}
+
+void AAdvancedSightVisibilityVolume::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (auto* SightSystem = GetWorld()->GetSubsystem<UAdvancedSightSystem>())
+	{
+		SightSystem->LoadVisibilitySet(GetLevel()->GetPackage()->GetName());
+	}
+}
+
+void AAdvancedSightVisibilityVolume::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (auto* SightSystem = GetWorld()->GetSubsystem<UAdvancedSightSystem>())
+	{
+		SightSystem->UnloadVisibilitySet(GetLevel()->GetPackage()->GetName());
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -0,0 +1,141 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "BTDecorator_AdvancedSight.h"
+
+#include "AdvancedSightComponent.h"
+#include "AIController.h"
+#include "BehaviorTree/BehaviorTreeComponent.h"
+
+UBTDecorator_AdvancedSight::UBTDecorator_AdvancedSight()
+{
+	NodeName = TEXT("Advanced Sight");
+	bNotifyBecomeRelevant = true;
+	bNotifyCeaseRelevant = true;
+	bAllowAbortNone = true;
+	bAllowAbortLowerPri = true;
+	bAllowAbortChildNodes = true;
+}
+
+uint16 UBTDecorator_AdvancedSight::GetInstanceMemorySize() const
+{
+	return sizeof(FBTAdvancedSightDecoratorMemory);
+}
+
+void UBTDecorator_AdvancedSight::InitializeMemory(
+	UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, EBTMemoryInit::Type InitType) const
+{
+	InitializeNodeMemory<FBTAdvancedSightDecoratorMemory>(NodeMemory, InitType);
+}
+
+void UBTDecorator_AdvancedSight::CleanupMemory(
+	UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, EBTMemoryClear::Type CleanupType) const
+{
+	CleanupNodeMemory<FBTAdvancedSightDecoratorMemory>(NodeMemory, CleanupType);
+}
+
+FString UBTDecorator_AdvancedSight::GetStaticDescription() const
+{
+	const UEnum* StateEnum = StaticEnum<EAdvancedSightTargetState>();
+	TArray<FString> StateNames;
+	for (int32 Index = 0; Index < StateEnum->NumEnums() - 1; Index++)
+	{
+		const int64 Value = StateEnum->GetValueByIndex(Index);
+		if (Value != 0 && (TargetStates & Value) != 0)
+		{
+			StateNames.Add(StateEnum->GetDisplayNameTextByIndex(Index).ToString());
+		}
+	}
+
+	return FString::Printf(
+		TEXT("%s: has %s target"), *Super::GetStaticDescription(), *FString::Join(StateNames, TEXT(" or ")));
+}
+
+bool UBTDecorator_AdvancedSight::CalculateRawConditionValue(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) const
+{
+	const UAdvancedSightComponent* SightComponent = UAdvancedSightComponent::FindSightComponent(OwnerComp.GetAIOwner());
+	if (!SightComponent)
+	{
+		return false;
+	}
+
+	const EAdvancedSightTargetState States = static_cast<EAdvancedSightTargetState>(TargetStates);
+	auto HasTargetsIn = [States](const EAdvancedSightTargetState State, const TArray<AActor*>& Targets)
+	{
+		return EnumHasAnyFlags(States, State) && !Targets.IsEmpty();
+	};
+	return HasTargetsIn(EAdvancedSightTargetState::Spotted, SightComponent->GetSpottedTargets())
+		|| HasTargetsIn(EAdvancedSightTargetState::Perceived, SightComponent->GetPerceivedTargets())
+		|| HasTargetsIn(EAdvancedSightTargetState::Remembered, SightComponent->GetRememberedTargets());
+}
+
+void UBTDecorator_AdvancedSight::OnBecomeRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	Super::OnBecomeRelevant(OwnerComp, NodeMemory);
+
+	FBTAdvancedSightDecoratorMemory* Memory = CastInstanceNodeMemory<FBTAdvancedSightDecoratorMemory>(NodeMemory);
+	if (UAdvancedSightComponent* SightComponent = UAdvancedSightComponent::FindSightComponent(OwnerComp.GetAIOwner()))
+	{
+		Memory->SightComponent = SightComponent;
+		Memory->TransitionDelegateHandle = SightComponent->OnTargetTransition.AddUObject(
+			this, &ThisClass::HandleTargetTransition, TWeakObjectPtr<UBehaviorTreeComponent>(&OwnerComp));
+	}
+}
+
+void UBTDecorator_AdvancedSight::OnCeaseRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	FBTAdvancedSightDecoratorMemory* Memory = CastInstanceNodeMemory<FBTAdvancedSightDecoratorMemory>(NodeMemory);
+	if (UAdvancedSightComponent* SightComponent = Memory->SightComponent.Get())
+	{
+		SightComponent->OnTargetTransition.Remove(Memory->TransitionDelegateHandle);
+	}
+
+	Memory->SightComponent = nullptr;
+	Memory->TransitionDelegateHandle.Reset();
+
+	Super::OnCeaseRelevant(OwnerComp, NodeMemory);
+}
+
+void UBTDecorator_AdvancedSight::HandleTargetTransition(
+	AActor* TargetActor, EAdvancedSightTransition Transition, TWeakObjectPtr<UBehaviorTreeComponent> OwnerComp)
+{
+	if (!OwnerComp.IsValid())
+	{
+		return;
+	}
+
+	bool bHasEnteredSelectedState = false;
+	if (bRestartOnNewTarget)
+	{
+		EAdvancedSightTargetState EnteredState = EAdvancedSightTargetState::None;
+		switch (Transition)
+		{
+		case EAdvancedSightTransition::Spotted:
+			EnteredState = EAdvancedSightTargetState::Spotted;
+			break;
+		case EAdvancedSightTransition::Perceived:
+			EnteredState = EAdvancedSightTargetState::Perceived;
+			break;
+		case EAdvancedSightTransition::Lost:
+			{
+				// Only perceived targets are remembered once they are lost
+				const UAdvancedSightComponent* SightComponent =
+					UAdvancedSightComponent::FindSightComponent(OwnerComp->GetAIOwner());
+				if (SightComponent && SightComponent->GetRememberedTargets().Contains(TargetActor))
+				{
+					EnteredState = EAdvancedSightTargetState::Remembered;
+				}
+			}
+			break;
+		default:
+			break;
+		}
+
+		bHasEnteredSelectedState =
+			EnumHasAnyFlags(EnteredState, static_cast<EAdvancedSightTargetState>(TargetStates));
+	}
+
+	const EBTDecoratorAbortRequest RequestMode = bHasEnteredSelectedState
+		? EBTDecoratorAbortRequest::ConditionPassing
+		: EBTDecoratorAbortRequest::ConditionResultChanged;
+	ConditionalFlowAbort(*OwnerComp, RequestMode);
+}
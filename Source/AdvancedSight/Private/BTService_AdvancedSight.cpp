@@ -0,0 +1,287 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "BTService_AdvancedSight.h"
+
+#include "AdvancedSightComponent.h"
+#include "AIController.h"
+#include "BehaviorTree/BehaviorTreeComponent.h"
+#include "BehaviorTree/BlackboardComponent.h"
+#include "BehaviorTree/Blackboard/BlackboardKeyType_Float.h"
+#include "BehaviorTree/Blackboard/BlackboardKeyType_Object.h"
+#include "BehaviorTree/Blackboard/BlackboardKeyType_Vector.h"
+
+namespace BTService_AdvancedSight
+{
+	// Perceived targets win over spotted ones, targets in neither list are never picked
+	int32 GetTargetPriority(const UAdvancedSightComponent& SightComponent, const AActor* TargetActor)
+	{
+		const EAdvancedSightTargetState State = SightComponent.GetTargetState(TargetActor);
+		if (EnumHasAnyFlags(State, EAdvancedSightTargetState::Perceived))
+		{
+			return 2;
+		}
+
+		return EnumHasAnyFlags(State, EAdvancedSightTargetState::Spotted) ? 1 : 0;
+	}
+}
+
+UBTService_AdvancedSight::UBTService_AdvancedSight()
+{
+	NodeName = TEXT("Advanced Sight");
+	bNotifyTick = false;
+	bNotifyBecomeRelevant = true;
+	bNotifyCeaseRelevant = true;
+
+	TargetActorKey.AddObjectFilter(this, GET_MEMBER_NAME_CHECKED(ThisClass, TargetActorKey), AActor::StaticClass());
+	LastKnownLocationKey.AddVectorFilter(this, GET_MEMBER_NAME_CHECKED(ThisClass, LastKnownLocationKey));
+	GainKey.AddFloatFilter(this, GET_MEMBER_NAME_CHECKED(ThisClass, GainKey));
+}
+
+void UBTService_AdvancedSight::InitializeFromAsset(UBehaviorTree& Asset)
+{
+	Super::InitializeFromAsset(Asset);
+
+	if (const UBlackboardData* BlackboardAsset = GetBlackboardAsset())
+	{
+		TargetActorKey.ResolveSelectedKey(*BlackboardAsset);
+		LastKnownLocationKey.ResolveSelectedKey(*BlackboardAsset);
+		GainKey.ResolveSelectedKey(*BlackboardAsset);
+	}
+}
+
+uint16 UBTService_AdvancedSight::GetInstanceMemorySize() const
+{
+	return sizeof(FBTAdvancedSightServiceMemory);
+}
+
+void UBTService_AdvancedSight::InitializeMemory(
+	UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, EBTMemoryInit::Type InitType) const
+{
+	InitializeNodeMemory<FBTAdvancedSightServiceMemory>(NodeMemory, InitType);
+}
+
+void UBTService_AdvancedSight::CleanupMemory(
+	UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, EBTMemoryClear::Type CleanupType) const
+{
+	// The tree can be torn down without the service ceasing to be relevant, the handlers must not outlive the memory
+	UnbindSightComponent(*CastInstanceNodeMemory<FBTAdvancedSightServiceMemory>(NodeMemory));
+	CleanupNodeMemory<FBTAdvancedSightServiceMemory>(NodeMemory, CleanupType);
+}
+
+FString UBTService_AdvancedSight::GetStaticDescription() const
+{
+	return FString::Printf(
+		TEXT("%s\nTarget: %s\nLast known location: %s\nGain: %s"),
+		*Super::GetStaticDescription(),
+		*TargetActorKey.SelectedKeyName.ToString(),
+		*LastKnownLocationKey.SelectedKeyName.ToString(),
+		*GainKey.SelectedKeyName.ToString());
+}
+
+void UBTService_AdvancedSight::OnBecomeRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	Super::OnBecomeRelevant(OwnerComp, NodeMemory);
+
+	FBTAdvancedSightServiceMemory* Memory = CastInstanceNodeMemory<FBTAdvancedSightServiceMemory>(NodeMemory);
+	UAdvancedSightComponent* SightComponent = UAdvancedSightComponent::FindSightComponent(OwnerComp.GetAIOwner());
+	if (!SightComponent)
+	{
+		return;
+	}
+
+	Memory->SightComponent = SightComponent;
+	Memory->TargetGains.Reset();
+	for (const TArray<AActor*>* Targets : { &SightComponent->GetPerceivedTargets(),
+		&SightComponent->GetSpottedTargets() })
+	{
+		for (AActor* Target : *Targets)
+		{
+			if (Target)
+			{
+				Memory->TargetGains.Add(Target, SightComponent->GetGainValueForTarget(Target));
+			}
+		}
+	}
+
+	const TWeakObjectPtr<UBehaviorTreeComponent> WeakOwnerComp = &OwnerComp;
+	Memory->TransitionDelegateHandle =
+		SightComponent->OnTargetTransition.AddUObject(this, &ThisClass::HandleTargetTransition, WeakOwnerComp);
+	Memory->GainDelegateHandle =
+		SightComponent->OnTargetGainChanged.AddUObject(this, &ThisClass::HandleTargetGainChanged, WeakOwnerComp);
+	if (LastKnownLocationKey.IsSet())
+	{
+		Memory->LocationDelegateHandle = SightComponent->OnTargetLastSeenLocationChanged.AddUObject(
+			this, &ThisClass::HandleTargetLastSeenLocationChanged, WeakOwnerComp);
+	}
+
+	SelectTopTarget(*SightComponent, *Memory);
+	UpdateBlackboard(OwnerComp, *Memory);
+}
+
+void UBTService_AdvancedSight::OnCeaseRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	UnbindSightComponent(*CastInstanceNodeMemory<FBTAdvancedSightServiceMemory>(NodeMemory));
+
+	Super::OnCeaseRelevant(OwnerComp, NodeMemory);
+}
+
+void UBTService_AdvancedSight::UnbindSightComponent(FBTAdvancedSightServiceMemory& Memory) const
+{
+	if (UAdvancedSightComponent* SightComponent = Memory.SightComponent.Get())
+	{
+		SightComponent->OnTargetTransition.Remove(Memory.TransitionDelegateHandle);
+		SightComponent->OnTargetGainChanged.Remove(Memory.GainDelegateHandle);
+		SightComponent->OnTargetLastSeenLocationChanged.Remove(Memory.LocationDelegateHandle);
+	}
+
+	Memory.SightComponent = nullptr;
+	Memory.TargetGains.Reset();
+	Memory.TopTarget = nullptr;
+	Memory.LocationTarget = nullptr;
+	Memory.TopTargetGain = 0.0f;
+	Memory.TransitionDelegateHandle.Reset();
+	Memory.GainDelegateHandle.Reset();
+	Memory.LocationDelegateHandle.Reset();
+}
+
+void UBTService_AdvancedSight::HandleTargetTransition(
+	AActor* TargetActor, EAdvancedSightTransition Transition, TWeakObjectPtr<UBehaviorTreeComponent> OwnerComp)
+{
+	FBTAdvancedSightServiceMemory* Memory = OwnerComp.IsValid() ? FindServiceMemory(*OwnerComp) : nullptr;
+	const UAdvancedSightComponent* SightComponent = Memory ? Memory->SightComponent.Get() : nullptr;
+	if (SightComponent)
+	{
+		SelectTopTarget(*SightComponent, *Memory);
+		UpdateBlackboard(*OwnerComp, *Memory);
+	}
+}
+
+void UBTService_AdvancedSight::HandleTargetGainChanged(
+	AActor* TargetActor, float GainValue, TWeakObjectPtr<UBehaviorTreeComponent> OwnerComp)
+{
+	FBTAdvancedSightServiceMemory* Memory = OwnerComp.IsValid() ? FindServiceMemory(*OwnerComp) : nullptr;
+	const UAdvancedSightComponent* SightComponent = Memory ? Memory->SightComponent.Get() : nullptr;
+	if (!SightComponent)
+	{
+		return;
+	}
+
+	if (GainValue > 0.0f)
+	{
+		Memory->TargetGains.Add(TargetActor, GainValue);
+	}
+	else
+	{
+		Memory->TargetGains.Remove(TargetActor);
+	}
+
+	const AActor* TopTarget = Memory->TopTarget.Get();
+	if (TargetActor == TopTarget && GainValue >= Memory->TopTargetGain)
+	{
+		Memory->TopTargetGain = GainValue;
+		UBlackboardComponent* BlackboardComponent = OwnerComp->GetBlackboardComponent();
+		if (BlackboardComponent && GainKey.IsSet())
+		{
+			BlackboardComponent->SetValue<UBlackboardKeyType_Float>(GainKey.GetSelectedKeyID(), GainValue);
+		}
+		return;
+	}
+
+	// Only a drop of the top target gain or another target overtaking it can change the ranking
+	const int32 Priority = BTService_AdvancedSight::GetTargetPriority(*SightComponent, TargetActor);
+	if (TargetActor == TopTarget || (Priority > 0 && GainValue > Memory->TopTargetGain
+		&& Priority >= BTService_AdvancedSight::GetTargetPriority(*SightComponent, TopTarget)))
+	{
+		SelectTopTarget(*SightComponent, *Memory);
+		UpdateBlackboard(*OwnerComp, *Memory);
+	}
+}
+
+void UBTService_AdvancedSight::HandleTargetLastSeenLocationChanged(
+	AActor* TargetActor, const FVector& Location, TWeakObjectPtr<UBehaviorTreeComponent> OwnerComp)
+{
+	const FBTAdvancedSightServiceMemory* Memory = OwnerComp.IsValid() ? FindServiceMemory(*OwnerComp) : nullptr;
+	UBlackboardComponent* BlackboardComponent = Memory ? OwnerComp->GetBlackboardComponent() : nullptr;
+	if (BlackboardComponent && TargetActor == Memory->LocationTarget.Get())
+	{
+		BlackboardComponent->SetValue<UBlackboardKeyType_Vector>(LastKnownLocationKey.GetSelectedKeyID(), Location);
+	}
+}
+
+FBTAdvancedSightServiceMemory* UBTService_AdvancedSight::FindServiceMemory(UBehaviorTreeComponent& OwnerComp)
+{
+	const int32 InstanceIndex = OwnerComp.FindInstanceContainingNode(this);
+	return InstanceIndex != INDEX_NONE
+		? CastInstanceNodeMemory<FBTAdvancedSightServiceMemory>(OwnerComp.GetNodeMemory(this, InstanceIndex))
+		: nullptr;
+}
+
+void UBTService_AdvancedSight::SelectTopTarget(
+	const UAdvancedSightComponent& SightComponent, FBTAdvancedSightServiceMemory& Memory) const
+{
+	AActor* TopTarget = nullptr;
+	float TopTargetGain = 0.0f;
+	const TArray<AActor*>* TargetsByPriority[] =
+	{
+		&SightComponent.GetPerceivedTargets(),
+		&SightComponent.GetSpottedTargets(),
+	};
+	for (const TArray<AActor*>* Targets : TargetsByPriority)
+	{
+		for (AActor* Target : *Targets)
+		{
+			const float Gain = Memory.TargetGains.FindRef(Target);
+			if (Target && (!TopTarget || Gain > TopTargetGain))
+			{
+				TopTarget = Target;
+				TopTargetGain = Gain;
+			}
+		}
+
+		if (TopTarget)
+		{
+			break;
+		}
+	}
+
+	Memory.TopTarget = TopTarget;
+	Memory.TopTargetGain = TopTargetGain;
+	const TArray<AActor*>& RememberedTargets = SightComponent.GetRememberedTargets();
+	Memory.LocationTarget = TopTarget || RememberedTargets.IsEmpty() ? TopTarget : RememberedTargets.Last();
+}
+
+void UBTService_AdvancedSight::UpdateBlackboard(
+	UBehaviorTreeComponent& OwnerComp, const FBTAdvancedSightServiceMemory& Memory) const
+{
+	UBlackboardComponent* BlackboardComponent = OwnerComp.GetBlackboardComponent();
+	const UAdvancedSightComponent* SightComponent = Memory.SightComponent.Get();
+	if (!BlackboardComponent || !SightComponent)
+	{
+		return;
+	}
+
+	// The blackboard only notifies observers when a value actually changes
+	if (TargetActorKey.IsSet())
+	{
+		BlackboardComponent->SetValue<UBlackboardKeyType_Object>(
+			TargetActorKey.GetSelectedKeyID(), Memory.TopTarget.Get());
+	}
+
+	if (GainKey.IsSet())
+	{
+		BlackboardComponent->SetValue<UBlackboardKeyType_Float>(GainKey.GetSelectedKeyID(), Memory.TopTargetGain);
+	}
+
+	if (LastKnownLocationKey.IsSet())
+	{
+		if (const AActor* LocationTarget = Memory.LocationTarget.Get())
+		{
+			BlackboardComponent->SetValue<UBlackboardKeyType_Vector>(
+				LastKnownLocationKey.GetSelectedKeyID(), SightComponent->GetLastKnownLocation(LocationTarget));
+		}
+		else
+		{
+			BlackboardComponent->ClearValue(LastKnownLocationKey.GetSelectedKeyID());
+		}
+	}
+}
@@ -0,0 +1,206 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "GameplayDebuggerCategory_AdvancedSight.h"
+
+#if WITH_GAMEPLAY_DEBUGGER
+
+#include "AdvancedSightSettings.h"
+#include "AdvancedSightSystem.h"
+#include "GameFramework/PlayerController.h"
+
+FGameplayDebuggerCategory_AdvancedSight::FGameplayDebuggerCategory_AdvancedSight()
+{
+	bShowOnlyWithDebugActor = false;
+	CollectDataInterval = 0.1f;
+}
+
+TSharedRef<FGameplayDebuggerCategory> FGameplayDebuggerCategory_AdvancedSight::MakeInstance()
+{
+	return MakeShareable(new FGameplayDebuggerCategory_AdvancedSight());
+}
+
+void FGameplayDebuggerCategory_AdvancedSight::CollectData(APlayerController* OwnerPC, AActor* DebugActor)
+{
+	const UWorld* World = OwnerPC ? OwnerPC->GetWorld() : nullptr;
+	const UAdvancedSightSystem* SightSystem = World ? World->GetSubsystem<UAdvancedSightSystem>() : nullptr;
+	if (!SightSystem)
+	{
+		AddTextLine(TEXT("{red}Advanced sight system is not available"));
+		return;
+	}
+
+	FVector Origin;
+	if (DebugActor)
+	{
+		Origin = DebugActor->GetActorLocation();
+	}
+	else
+	{
+		FRotator ViewRotation;
+		OwnerPC->GetPlayerViewPoint(Origin, ViewRotation);
+	}
+
+	const FDebugDrawInfo& DebugDrawInfo = GetDefault<UAdvancedSightSettings>()->DebugDrawInfo;
+	TArray<FAdvancedSightListenerDebugInfo> ListenerInfos;
+	SightSystem->GatherDebugInfo(Origin, DebugDrawInfo.GameplayDebuggerRadius, ListenerInfos);
+	ListenerInfos.Sort([&Origin](const FAdvancedSightListenerDebugInfo& Lhs, const FAdvancedSightListenerDebugInfo& Rhs)
+	{
+		return FVector::DistSquared(Lhs.EyeLocation, Origin) < FVector::DistSquared(Rhs.EyeLocation, Origin);
+	});
+
+	int32 NumDormantListeners = 0;
+	for (const FAdvancedSightListenerDebugInfo& ListenerInfo : ListenerInfos)
+	{
+		NumDormantListeners += ListenerInfo.bIsDormant ? 1 : 0;
+	}
+
+	AddTextLine(FString::Printf(
+		TEXT("Listeners in range: {yellow}%d{white}, dormant: {yellow}%d{white}, dormant in world: {yellow}%d"),
+		ListenerInfos.Num(),
+		NumDormantListeners,
+		SightSystem->GetNumDormantListeners()));
+
+	for (int32 ListenerIndex = 0; ListenerIndex < ListenerInfos.Num(); ListenerIndex++)
+	{
+		const FAdvancedSightListenerDebugInfo& ListenerInfo = ListenerInfos[ListenerIndex];
+		int32 NumVisible = 0;
+		int32 NumPerceived = 0;
+		int32 NumGaining = 0;
+		for (const FAdvancedSightTargetDebugInfo& TargetInfo : ListenerInfo.Targets)
+		{
+			NumVisible += TargetInfo.bIsVisible ? 1 : 0;
+			NumPerceived += TargetInfo.bIsPerceived ? 1 : 0;
+			NumGaining += (TargetInfo.bIsVisible && TargetInfo.GainValue < 1.0f) ? 1 : 0;
+		}
+
+		AddTextLine(FString::Printf(
+			TEXT("%s%s{white} queries: %d, visible: %d, perceived: %d, gaining: %d"),
+			ListenerInfo.bIsDormant ? TEXT("{grey}") : TEXT("{green}"),
+			*ListenerInfo.Name,
+			ListenerInfo.NumQueries,
+			NumVisible,
+			NumPerceived,
+			NumGaining));
+
+		if (ListenerIndex >= DebugDrawInfo.GameplayDebuggerMaxDrawnListeners || ListenerInfo.bIsDormant)
+		{
+			continue;
+		}
+
+		const FVector& EyeLocation = ListenerInfo.EyeLocation;
+		for (const FAdvancedSightCone& Cone : ListenerInfo.Cones)
+		{
+			AddConeShapes(Cone, EyeLocation, ListenerInfo.EyeForward);
+		}
+
+		AddShape(FGameplayDebuggerShape::MakeCylinder(EyeLocation, ListenerInfo.LoseSightRadius, 1.0f, FColor::Black));
+
+		for (const FAdvancedSightTargetDebugInfo& TargetInfo : ListenerInfo.Targets)
+		{
+			if (!TargetInfo.bIsVisible && TargetInfo.bIsPerceived)
+			{
+				AddShape(FGameplayDebuggerShape::MakeSegment(
+					EyeLocation, TargetInfo.LastSeenLocation, 1.0f, DebugDrawInfo.LastKnownLocationColor));
+				AddShape(FGameplayDebuggerShape::MakePoint(
+					TargetInfo.LastSeenLocation, DebugDrawInfo.VisibilityPointRadius, DebugDrawInfo.LastKnownLocationColor));
+				continue;
+			}
+
+			const FColor VisibleColor = TargetInfo.bIsPerceived
+				? DebugDrawInfo.PerceivedTarget_VisibleColor
+				: DebugDrawInfo.SpottedTarget_VisibleColor;
+			const FColor UnconfirmedColor = TargetInfo.bIsPerceived
+				? DebugDrawInfo.PerceivedTarget_UnconfirmedColor
+				: DebugDrawInfo.SpottedTarget_UnconfirmedColor;
+			for (int32 PointIndex = 0; PointIndex < TargetInfo.VisibilityPoints.Num(); PointIndex++)
+			{
+				const bool bIsPointVisible = ((TargetInfo.VisibilityPointsFlags >> PointIndex) & 1) != 0;
+				const FColor& PointColor = bIsPointVisible ? VisibleColor : UnconfirmedColor;
+				AddShape(FGameplayDebuggerShape::MakePoint(
+					TargetInfo.VisibilityPoints[PointIndex], DebugDrawInfo.VisibilityPointRadius, PointColor));
+				if (bIsPointVisible)
+				{
+					AddShape(FGameplayDebuggerShape::MakeSegment(
+						EyeLocation, TargetInfo.VisibilityPoints[PointIndex], 1.0f, PointColor));
+				}
+			}
+
+			AddShape(FGameplayDebuggerShape::MakePoint(
+				TargetInfo.Location,
+				DebugDrawInfo.VisibilityPointRadius,
+				DebugDrawInfo.NotPerceivedColor,
+				FString::Printf(TEXT("%.2f"), TargetInfo.GainValue)));
+		}
+	}
+}
+
+void FGameplayDebuggerCategory_AdvancedSight::AddConeShapes(
+	const FAdvancedSightCone& Cone, const FVector& EyeLocation, const FVector& EyeForward)
+{
+	// Same eye basis as the shape kernels
+	const FMatrix EyeMatrix = FRotationMatrix::MakeFromX(EyeForward);
+	const FVector Forward = EyeMatrix.GetScaledAxis(EAxis::X);
+	const FVector Right = EyeMatrix.GetScaledAxis(EAxis::Y);
+	const FVector Up = EyeMatrix.GetScaledAxis(EAxis::Z);
+	if (Cone.Shape == EAdvancedSightConeShape::Box)
+	{
+		FVector Corners[8];
+		for (int32 CornerIndex = 0; CornerIndex < 8; CornerIndex++)
+		{
+			const float Depth = (CornerIndex & 4) ? Cone.GainRadius : 0.0f;
+			const float Horizontal = (CornerIndex & 1) ? Cone.BoxHalfSize.X : -Cone.BoxHalfSize.X;
+			const float Vertical = (CornerIndex & 2) ? Cone.BoxHalfSize.Y : -Cone.BoxHalfSize.Y;
+			Corners[CornerIndex] = EyeLocation + Forward * Depth + Right * Horizontal + Up * Vertical;
+		}
+
+		constexpr int32 Edges[12][2] = {
+			{ 0, 1 }, { 1, 3 }, { 3, 2 }, { 2, 0 }, { 4, 5 }, { 5, 7 }, { 7, 6 }, { 6, 4 }, { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 } };
+		for (const int32* Edge : Edges)
+		{
+			AddShape(FGameplayDebuggerShape::MakeSegment(Corners[Edge[0]], Corners[Edge[1]], 1.0f, FColor::Green));
+		}
+		return;
+	}
+
+	// Rim of the shape at the gain radius, walked around the forward axis. Frustum corners fall on the diagonals.
+	constexpr int32 NumRimPoints = 24;
+	const float SinHalfFOV = FMath::Sqrt(FMath::Max(1.0f - FMath::Square(Cone.CosHalfFOV), 0.0f));
+	FVector RimPoints[NumRimPoints];
+	for (int32 PointIndex = 0; PointIndex < NumRimPoints; PointIndex++)
+	{
+		float Sin, Cos;
+		FMath::SinCos(&Sin, &Cos, UE_TWO_PI * PointIndex / NumRimPoints);
+		FVector Direction;
+		switch (Cone.Shape)
+		{
+		case EAdvancedSightConeShape::Frustum:
+			{
+				const float SquareScale = 1.0f / FMath::Max(FMath::Abs(Cos), FMath::Abs(Sin));
+				Direction = Forward
+					+ Right * (Cone.TanHalfFOV * Cos * SquareScale)
+					+ Up * (Cone.TanHalfVerticalFOV * Sin * SquareScale);
+				break;
+			}
+		case EAdvancedSightConeShape::Ellipse:
+			Direction = Forward + Right * (Cone.TanHalfFOV * Cos) + Up * (Cone.TanHalfVerticalFOV * Sin);
+			break;
+		default:
+			Direction = Forward * Cone.CosHalfFOV + (Right * Cos + Up * Sin) * SinHalfFOV;
+			break;
+		}
+		RimPoints[PointIndex] = EyeLocation + Direction.GetSafeNormal() * Cone.GainRadius;
+	}
+
+	const int32 EdgeOffset = Cone.Shape == EAdvancedSightConeShape::Frustum ? NumRimPoints / 8 : 0;
+	for (int32 PointIndex = 0; PointIndex < NumRimPoints; PointIndex++)
+	{
+		const FVector& NextRimPoint = RimPoints[(PointIndex + 1) % NumRimPoints];
+		AddShape(FGameplayDebuggerShape::MakeSegment(RimPoints[PointIndex], NextRimPoint, 1.0f, FColor::Green));
+		if (PointIndex % (NumRimPoints / 4) == EdgeOffset)
+		{
+			AddShape(FGameplayDebuggerShape::MakeSegment(EyeLocation, RimPoints[PointIndex], 1.0f, FColor::Green));
+		}
+	}
+}
+
+#endif // WITH_GAMEPLAY_DEBUGGER
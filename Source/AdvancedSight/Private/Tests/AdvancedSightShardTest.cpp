@@ -0,0 +1,197 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#include "AdvancedSightShard.h"
+#include "AdvancedSightSettings.h"
+#include "AdvancedSightSystem.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Listeners and targets are placed around cell borders and corners. The sharded path may only skip pairs farther apart
+// than the broadphase radius, so after the exact distance check it has to pick the same targets as checking every pair.
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAdvancedSightShardCellBordersTest, "AdvancedSight.Shards.CellBorders",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FAdvancedSightShardCellBordersTest::RunTest(const FString& Parameters)
+{
+	constexpr float CellSize = 1000.0f;
+	constexpr int32 NumListeners = 64;
+	constexpr uint32 NumTargets = 512;
+	const float Radii[] = { 10.0f, 500.0f, 999.0f, 1000.0f, 2500.0f };
+
+	FRandomStream Random(0x41535354);
+	auto GetBorderLocation = [&Random]()
+	{
+		// Snapping to a border and nudging by at most a few units keeps most points right next to a cell edge
+		const float X = FMath::RoundToFloat(Random.FRandRange(-4.0f, 4.0f)) * CellSize + Random.FRandRange(-2.0f, 2.0f);
+		const float Y = FMath::RoundToFloat(Random.FRandRange(-4.0f, 4.0f)) * CellSize + Random.FRandRange(-2.0f, 2.0f);
+		return FVector(X, Y, Random.FRandRange(-100.0f, 100.0f));
+	};
+
+	TArray<FVector> TargetLocations;
+	FAdvancedSightShardGrid Grid;
+	Grid.Reset(CellSize);
+	for (uint32 TargetId = 0; TargetId < NumTargets; TargetId++)
+	{
+		const FVector Location = GetBorderLocation();
+		TargetLocations.Add(Location);
+		Grid.AddTarget(Grid.GetCell(Location), TargetId);
+	}
+
+	TArray<FVector> ListenerLocations;
+	for (int32 ListenerIndex = 0; ListenerIndex < NumListeners; ListenerIndex++)
+	{
+		ListenerLocations.Add(GetBorderLocation());
+		Grid.AddListener(Grid.GetCell(ListenerLocations.Last()), ListenerIndex);
+	}
+	Grid.FinishBuild();
+
+	for (const float Radius : Radii)
+	{
+		for (const FVector& ListenerLocation : ListenerLocations)
+		{
+			TArray<uint32> Expected;
+			for (uint32 TargetId = 0; TargetId < NumTargets; TargetId++)
+			{
+				if (FVector::DistSquared(ListenerLocation, TargetLocations[TargetId]) <= FMath::Square(Radius))
+				{
+					Expected.Add(TargetId);
+				}
+			}
+
+			FIntPoint MinCell;
+			FIntPoint MaxCell;
+			Grid.GetCellRange(ListenerLocation, Radius, MinCell, MaxCell);
+			TArray<uint32> InReach;
+			for (uint32 TargetId = 0; TargetId < NumTargets; TargetId++)
+			{
+				const FVector& TargetLocation = TargetLocations[TargetId];
+				if (FAdvancedSightShardGrid::IsCellInRange(Grid.GetCell(TargetLocation), MinCell, MaxCell)
+					&& FVector::DistSquared(ListenerLocation, TargetLocation) <= FMath::Square(Radius))
+				{
+					InReach.Add(TargetId);
+				}
+			}
+
+			TArray<uint32> Gathered;
+			Grid.GatherTargetIds(ListenerLocation, Radius, Gathered);
+			Gathered.RemoveAll([&TargetLocations, &ListenerLocation, Radius](const uint32 TargetId)
+			{
+				return FVector::DistSquared(ListenerLocation, TargetLocations[TargetId]) > FMath::Square(Radius);
+			});
+			Gathered.Sort();
+
+			const FString Context =
+				FString::Printf(TEXT("listener at %s, radius %.0f"), *ListenerLocation.ToString(), Radius);
+			TestTrue(FString::Printf(TEXT("Queries in reach match, %s"), *Context), InReach == Expected);
+			TestTrue(FString::Printf(TEXT("Gathered targets match, %s"), *Context), Gathered == Expected);
+		}
+	}
+
+	return true;
+}
+
+struct FAdvancedSightSystemTestAccess
+{
+	static void AddListener(UAdvancedSightSystem& System, const uint32 ListenerId, const float BroadphaseRadius)
+	{
+		System.ListenerQueries.Add(ListenerId).Profile.BroadphaseRadius = BroadphaseRadius;
+	}
+
+	static void AddPair(UAdvancedSightSystem& System, const uint32 ListenerId, const uint32 TargetId,
+		const FVector& TargetLocation, const float GainValue)
+	{
+		FAdvancedSightQuery& Query = System.Queries.AddDefaulted_GetRef();
+		Query.ListenerId = ListenerId;
+		Query.TargetId = TargetId;
+		Query.GainValue = GainValue;
+		System.QueriesColdData.AddDefaulted();
+		System.TargetSnapshots.FindOrAdd(TargetId).Location = TargetLocation;
+		System.UpdateStatefulTarget(Query);
+		System.bIsQueryLayoutDirty = true;
+	}
+
+	static void SetGain(UAdvancedSightSystem& System, const uint32 ListenerId, const uint32 TargetId, const float GainValue)
+	{
+		FAdvancedSightQuery& Query = System.Queries[System.FindQueryIndex(ListenerId, TargetId)];
+		Query.GainValue = GainValue;
+		System.UpdateStatefulTarget(Query);
+	}
+
+	// Runs the gathering of an update in which the listener is the only active one, returns the gathered targets
+	static TArray<uint32> GatherTargets(UAdvancedSightSystem& System, const uint32 ListenerId, const FVector& BodyLocation)
+	{
+		System.ConditionalRebuildQueryLayout();
+		System.ActiveQueryIndices.Reset();
+		System.ActiveQueryListenerIndices.Reset();
+		System.ActiveListeners.Reset();
+
+		FAdvancedSightListenerQueries& ListenerEntry = System.ListenerQueries[ListenerId];
+		FAdvancedSightActiveListener& ActiveListener = System.ActiveListeners.AddDefaulted_GetRef();
+		ActiveListener.ListenerId = ListenerId;
+		ActiveListener.BodyLocation = BodyLocation;
+		ActiveListener.Profile = &ListenerEntry.Profile;
+		ActiveListener.FirstQueryIndex = ListenerEntry.FirstQueryIndex;
+		ActiveListener.NumQueries = ListenerEntry.NumQueries;
+		ActiveListener.bIsInStaggerGroup = true;
+		System.BuildShards();
+		System.GatherActiveQueries();
+
+		TArray<uint32> TargetIds;
+		for (const int32 QueryIndex : System.ActiveQueryIndices)
+		{
+			TargetIds.Add(System.Queries[QueryIndex].TargetId);
+		}
+		TargetIds.Sort();
+		return TargetIds;
+	}
+};
+
+// A listener right next to a cell border reaches a target across it, far targets are only gathered while their pair
+// has some state left to run down.
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAdvancedSightShardGatherQueriesTest, "AdvancedSight.Shards.GatherQueries",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FAdvancedSightShardGatherQueriesTest::RunTest(const FString& Parameters)
+{
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	UAdvancedSightSystem* System = World->GetSubsystem<UAdvancedSightSystem>();
+	if (!TestNotNull(TEXT("Sight system"), System))
+	{
+		World->DestroyWorld(false);
+		return false;
+	}
+
+	const float CellSize = GetDefault<UAdvancedSightSettings>()->ShardCellSize;
+	const FVector ListenerLocation(CellSize - 10.0f, CellSize * 0.5f, 0.0f);
+	constexpr uint32 ListenerId = 1;
+	constexpr uint32 AcrossBorderTarget = 10;
+	constexpr uint32 FarTarget = 11;
+	constexpr uint32 FarStatefulTarget = 12;
+
+	// Added out of target order, the layout rebuild sorts them for the lookups of the shards
+	FAdvancedSightSystemTestAccess::AddListener(*System, ListenerId, 100.0f);
+	FAdvancedSightSystemTestAccess::AddPair(
+		*System, ListenerId, FarStatefulTarget, ListenerLocation + FVector(CellSize * 3.0f, 0.0f, 0.0f), 0.5f);
+	FAdvancedSightSystemTestAccess::AddPair(
+		*System, ListenerId, AcrossBorderTarget, ListenerLocation + FVector(100.0f, 0.0f, 0.0f), 0.0f);
+	FAdvancedSightSystemTestAccess::AddPair(
+		*System, ListenerId, FarTarget, ListenerLocation + FVector(CellSize * 3.0f, 100.0f, 0.0f), 0.0f);
+
+	const TArray<uint32> Gathered = FAdvancedSightSystemTestAccess::GatherTargets(*System, ListenerId, ListenerLocation);
+	TestTrue(TEXT("Pair across the border is gathered"), Gathered.Contains(AcrossBorderTarget));
+	TestTrue(TEXT("Far pair with state is gathered"), Gathered.Contains(FarStatefulTarget));
+	TestFalse(TEXT("Far pair without state is skipped"), Gathered.Contains(FarTarget));
+
+	FAdvancedSightSystemTestAccess::SetGain(*System, ListenerId, FarStatefulTarget, 0.0f);
+	const TArray<uint32> GatheredWithoutState =
+		FAdvancedSightSystemTestAccess::GatherTargets(*System, ListenerId, ListenerLocation);
+	TestTrue(TEXT("Only the pair across the border is left once the state ran out"),
+		GatheredWithoutState == TArray<uint32>({ AcrossBorderTarget }));
+
+	World->DestroyWorld(false);
+	return true;
+}
+
+#endif
@@ -0,0 +1,78 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSightQuery.h"
+#include "AdvancedSightShard.h"
+#include "AdvancedSense.generated.h"
+
+USTRUCT(BlueprintType)
+struct ADVANCEDSIGHT_API FAdvancedSenseStimulus
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	FName SenseName;
+
+	UPROPERTY(BlueprintReadOnly)
+	TObjectPtr<AActor> SourceActor;
+
+	UPROPERTY(BlueprintReadOnly)
+	FVector Location = FVector::ZeroVector;
+
+	UPROPERTY(BlueprintReadOnly)
+	float Strength = 1.0f;
+
+	// False once a continuously sensed source stops being sensed
+	UPROPERTY(BlueprintReadOnly)
+	bool bIsActive = true;
+};
+
+struct FAdvancedSenseEvent
+{
+	uint32 ListenerId = UINT32_MAX;
+	// Registered target that caused the event, resolved by the sight system before it is delivered
+	uint32 TargetId = UINT32_MAX;
+	// Used instead of the target when the source is not a registered target, e.g. the instigator of a noise
+	TWeakObjectPtr<AActor> SourceActor;
+	FName SenseName;
+	FVector Location = FVector::ZeroVector;
+	float Strength = 1.0f;
+	bool bIsActive = true;
+};
+
+// Data of the current sight system update shared by every sense. Listeners are every listener that is not dormant,
+// only the ones flagged as in the stagger group are due for an update of continuous senses.
+struct ADVANCEDSIGHT_API FAdvancedSenseUpdateContext
+{
+	float DeltaTime = 0.0f;
+	TConstArrayView<FAdvancedSightActiveListener> Listeners;
+	const TMap<uint32, FAdvancedSightTargetSnapshot>& Targets;
+	const FAdvancedSightShardGrid& ShardGrid;
+
+	FAdvancedSenseUpdateContext(
+		const float InDeltaTime,
+		TConstArrayView<FAdvancedSightActiveListener> InListeners,
+		const TMap<uint32, FAdvancedSightTargetSnapshot>& InTargets,
+		const FAdvancedSightShardGrid& InShardGrid);
+
+	void GatherTargetsInRadius(
+		const FVector& Location, const float Radius, const AActor* IgnoredActor, TArray<uint32>& OutTargetIds) const;
+};
+
+// Sense evaluated by the sight system as part of its update. PrepareUpdate and FinishUpdate run on the game thread,
+// work items are evaluated in the same parallel pass as the sight queries and must only write data of their own item.
+class ADVANCEDSIGHT_API FAdvancedSenseBase
+{
+public:
+	virtual ~FAdvancedSenseBase() = default;
+
+	virtual FName GetSenseName() const = 0;
+	// Returns the number of work items to evaluate in this update
+	virtual int32 PrepareUpdate(const FAdvancedSenseUpdateContext& Context) = 0;
+	virtual void EvaluateWorkItem(const int32 Index, const FAdvancedSenseUpdateContext& Context) = 0;
+	virtual void FinishUpdate(const FAdvancedSenseUpdateContext& Context, TArray<FAdvancedSenseEvent>& OutEvents) = 0;
+	virtual void OnListenerRemoved(const uint32 ListenerId) {}
+	virtual void OnTargetRemoved(const uint32 TargetId) {}
+};
@@ -0,0 +1,36 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSense.h"
+
+// Hears noise events reported to the sight system within the listener hearing radius scaled by the loudness. Noise
+// is delivered to every listener that is not dormant, regardless of its stagger group.
+class ADVANCEDSIGHT_API FAdvancedSenseHearing : public FAdvancedSenseBase
+{
+public:
+	static const FName SenseName;
+
+	void ReportNoiseEvent(const FVector& Location, const float Loudness, AActor* Instigator, const float MaxRange);
+
+	virtual FName GetSenseName() const override;
+	virtual int32 PrepareUpdate(const FAdvancedSenseUpdateContext& Context) override;
+	virtual void EvaluateWorkItem(const int32 Index, const FAdvancedSenseUpdateContext& Context) override;
+	virtual void FinishUpdate(const FAdvancedSenseUpdateContext& Context, TArray<FAdvancedSenseEvent>& OutEvents) override;
+private:
+	struct FNoiseEvent
+	{
+		FVector Location = FVector::ZeroVector;
+		float Loudness = 1.0f;
+		float MaxRange = 0.0f;
+		TWeakObjectPtr<AActor> Instigator;
+		// Resolved on the game thread, only compared against by the workers
+		const AActor* ResolvedInstigator = nullptr;
+	};
+
+	TArray<FNoiseEvent> PendingNoiseEvents;
+	TArray<FNoiseEvent> NoiseEvents;
+	// Indices of the heard noise events per listener of the context
+	TArray<TArray<int32, TInlineAllocator<4>>> HeardNoiseEvents;
+};
@@ -0,0 +1,25 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSense.h"
+
+// Senses registered targets within the listener proximity radius regardless of sight. An active stimulus is sent when
+// a target comes into the radius and an inactive one when it leaves it.
+class ADVANCEDSIGHT_API FAdvancedSenseProximity : public FAdvancedSenseBase
+{
+public:
+	static const FName SenseName;
+
+	virtual FName GetSenseName() const override;
+	virtual int32 PrepareUpdate(const FAdvancedSenseUpdateContext& Context) override;
+	virtual void EvaluateWorkItem(const int32 Index, const FAdvancedSenseUpdateContext& Context) override;
+	virtual void FinishUpdate(const FAdvancedSenseUpdateContext& Context, TArray<FAdvancedSenseEvent>& OutEvents) override;
+	virtual void OnListenerRemoved(const uint32 ListenerId) override;
+	virtual void OnTargetRemoved(const uint32 TargetId) override;
+private:
+	// Per listener of the context, sorted
+	TArray<TArray<uint32>> CurrentNearbyTargets;
+	TMap<uint32, TArray<uint32>> NearbyTargets;
+};
@@ -4,4 +4,6 @@
 
 #include "CoreMinimal.h"
 
-DECLARE_LOG_CATEGORY_EXTERN(LogAdvancedSight, Log, All);
\ No newline at end of file
+DECLARE_LOG_CATEGORY_EXTERN(LogAdvancedSight, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("AdvancedSight"), STATGROUP_AdvancedSight, STATCAT_Advanced);
\ No newline at end of file
@@ -3,13 +3,24 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "AdvancedSense.h"
+#include "AdvancedSightQuery.h"
+#include "AdvancedSightReplication.h"
 #include "Components/ActorComponent.h"
 #include "AdvancedSightComponent.generated.h"
 
 class UAdvancedSightSystem;
 class UAdvancedSightData;
+class UAdvancedSightReplicationComponent;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FAdvancedSightComponentDelegate, AActor*, TargetActor);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FAdvancedSenseComponentDelegate, const FAdvancedSenseStimulus&, Stimulus);
+DECLARE_MULTICAST_DELEGATE_TwoParams(
+	FAdvancedSightTransitionNativeDelegate, AActor* /* TargetActor */, EAdvancedSightTransition /* Transition */);
+DECLARE_MULTICAST_DELEGATE_TwoParams(
+	FAdvancedSightGainNativeDelegate, AActor* /* TargetActor */, float /* GainValue */);
+DECLARE_MULTICAST_DELEGATE_TwoParams(
+	FAdvancedSightLocationNativeDelegate, AActor* /* TargetActor */, const FVector& /* Location */);
 
 UCLASS(ClassGroup=(AI), meta=(BlueprintSpawnableComponent))
 class ADVANCEDSIGHT_API UAdvancedSightComponent : public UActorComponent
@@ -30,12 +41,28 @@ public:
 	UFUNCTION(BlueprintPure)
 	AActor* GetBodyActor() const;
 
+	// Adds the body and, when enabled, the actors attached to it, e.g. a held weapon
+	void AddIgnoredActors(FCollisionQueryParams& QueryParams) const;
+
 	UFUNCTION(BlueprintPure)
 	bool IsTargetPerceived(const AActor* TargetActor) const;
 
+	// Adds or removes only the queries of targets in the category, e.g. to look for corpses while searching
+	UFUNCTION(BlueprintCallable)
+	void SetTargetCategoryEnabled(const EAdvancedSightTargetCategory Category, const bool bEnabled);
+
+	UFUNCTION(BlueprintPure)
+	bool IsTargetCategoryEnabled(const EAdvancedSightTargetCategory Category) const;
+
+	uint8 GetSubscribedCategories() const;
+
 	UFUNCTION(BlueprintPure)
 	float GetGainValueForTarget(const AActor* TargetActor) const;
 
+	// Only available on the authority, last known locations are not replicated
+	UFUNCTION(BlueprintPure)
+	FVector GetLastKnownLocation(const AActor* TargetActor) const;
+
 	UFUNCTION(BlueprintCallable)
 	const TArray<AActor*>& GetPerceivedTargets() const;
 
@@ -45,10 +72,21 @@ public:
 	UFUNCTION(BlueprintCallable)
 	const TArray<AActor*>& GetRememberedTargets() const;
 
+	EAdvancedSightTargetState GetTargetState(const AActor* TargetActor) const;
+
+	// Returns the sight component of the actor, or of its pawn or controller when it does not have one
+	static UAdvancedSightComponent* FindSightComponent(const AActor* Actor);
+
 	void SpotTarget(AActor* TargetActor);
 	void PerceiveTarget(AActor* TargetActor);
 	void LoseTarget(AActor* TargetActor);
 	void ForgetTarget(AActor* TargetActor);
+	// Replaces the target lists without broadcasting, used when restoring a perception snapshot
+	void RestoreTargets(
+		TArray<AActor*>&& InPerceivedTargets, TArray<AActor*>&& InSpottedTargets, TArray<AActor*>&& InRememberedTargets);
+	// Called by the sight system whenever the gain of a target changes by at least one quantization step
+	void SetQuantizedGain(AActor* TargetActor, const uint8 QuantizedGain);
+	void ReceiveStimulus(const FAdvancedSenseStimulus& Stimulus);
 
 	UPROPERTY(BlueprintAssignable)
 	FAdvancedSightComponentDelegate OnTargetSpotted;
@@ -61,10 +99,47 @@ public:
 
 	UPROPERTY(BlueprintAssignable)
 	FAdvancedSightComponentDelegate OnTargetForgot;
+
+	// Stimuli of the senses other than sight, e.g. hearing and proximity
+	UPROPERTY(BlueprintAssignable)
+	FAdvancedSenseComponentDelegate OnSenseStimulus;
+
+	// Native counterparts of the delegates above in a single event, broadcast after the target lists are updated
+	FAdvancedSightTransitionNativeDelegate OnTargetTransition;
+	// Broadcast only when the gain changes by at least 1/255, the same precision it is replicated with
+	FAdvancedSightGainNativeDelegate OnTargetGainChanged;
+	// Broadcast by the authority when a visible target moved LastSeenLocationReportDistance away from where it was last
+	// reported, or changed state. Last known locations are not replicated.
+	FAdvancedSightLocationNativeDelegate OnTargetLastSeenLocationChanged;
 protected:
+	// Finds or adds the replication component of the current body, or returns null when the state is not replicated
+	UAdvancedSightReplicationComponent* GetReplicationComponent();
+	void UpdateReplicatedTarget(AActor* TargetActor);
+
+	const USceneComponent* FindEyeComponent(const AActor* BodyActor) const;
+
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
 	TObjectPtr<UAdvancedSightData> SightData;
 
+	// Eyes follow the body component with this tag, or the first one with the eye socket when no tag is set. Without
+	// either the eyes are placed at the actor eyes view point, which follows the base eye height of pawns.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	FName EyeComponentTag;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	FName EyeSocketName;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	bool bIgnoreAttachedActors = true;
+
+	// Sends the spotted, perceived and remembered targets and their gain to clients through a replication component
+	// on the body, which has to replicate itself. Sight is only simulated by the authority.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	bool bReplicatePerceptionState = false;
+
+	// Starts from the subscribed categories of the sight data
+	uint8 SubscribedCategories = 0;
+
 	UPROPERTY(Transient)
 	TArray<TObjectPtr<AActor>> PerceivedTargets;
 
@@ -75,4 +150,8 @@ protected:
 	TArray<TObjectPtr<AActor>> RememberedTargets;
 
 	TWeakObjectPtr<UAdvancedSightSystem> AdvancedSightSystem;
+	TWeakObjectPtr<UAdvancedSightReplicationComponent> CachedReplicationComponent;
+	// Resolved again whenever the body changes, e.g. when the controller possesses another pawn
+	mutable TWeakObjectPtr<const AActor> CachedEyeBodyActor;
+	mutable TWeakObjectPtr<const USceneComponent> CachedEyeComponent;
 };
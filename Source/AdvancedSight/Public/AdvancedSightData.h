@@ -3,10 +3,93 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Curves/CurveFloat.h"
 #include "Engine/DataAsset.h"
 #include "Perception/AIPerceptionTypes.h"
 #include "AdvancedSightData.generated.h"
 
+// Gain falloff curves sampled once at load, so worker threads never touch the curve objects
+struct ADVANCEDSIGHT_API FAdvancedSightGainTable
+{
+	static constexpr int32 NumSamples = 32;
+
+	float DistanceSamples[NumSamples];
+	float AngleSamples[NumSamples];
+
+	void Bake(const FRichCurve* DistanceCurve, const FRichCurve* AngleCurve);
+	float Sample(const float NormalizedDistance, const float NormalizedAngle) const;
+};
+
+UENUM(BlueprintType)
+enum class EAdvancedSightConeShape : uint8
+{
+	// Round cone limited by the FOV in every direction
+	Cone,
+	// Pyramid with separate horizontal and vertical FOV
+	Frustum,
+	// Elliptical cone with separate horizontal and vertical FOV, e.g. for peripheral vision
+	Ellipse,
+	// Box in front of the eyes as deep as the gain radius, e.g. for security cameras
+	Box,
+};
+
+// Listeners only get queries for targets of the categories they subscribe to
+UENUM(BlueprintType, meta = (Bitflags, UseEnumValuesAsMaskValuesInEditor = "true"))
+enum class EAdvancedSightTargetCategory : uint8
+{
+	None = 0 UMETA(Hidden),
+	Character = 1 << 0,
+	Corpse = 1 << 1,
+	Door = 1 << 2,
+	Item = 1 << 3,
+	Custom0 = 1 << 4,
+	Custom1 = 1 << 5,
+	Custom2 = 1 << 6,
+	Custom3 = 1 << 7,
+};
+ENUM_CLASS_FLAGS(EAdvancedSightTargetCategory);
+
+static constexpr int32 NumAdvancedSightTargetCategories = 8;
+
+USTRUCT(BlueprintType)
+struct ADVANCEDSIGHT_API FAdvancedSightCategoryTuning
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	EAdvancedSightTargetCategory Category = EAdvancedSightTargetCategory::Character;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (ClampMin = "0.0"))
+	float GainMultiplier = 1.0f;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (ClampMin = "0.0"))
+	float LoseSightRadiusMultiplier = 1.0f;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (ClampMin = "0.0"))
+	float LoseSightCooldownMultiplier = 1.0f;
+};
+
+// Runtime representation of a sight info used by the sight system queries
+struct ADVANCEDSIGHT_API FAdvancedSightCone
+{
+	EAdvancedSightConeShape Shape = EAdvancedSightConeShape::Cone;
+	float GainRadius = 1000.0f;
+	float FOV = 90.0f;
+	float VerticalFOV = 60.0f;
+	FVector2D BoxHalfSize = FVector2D(200.0f, 100.0f);
+	float GainMultiplier = 1.0f;
+	TSharedPtr<const FAdvancedSightGainTable> GainTable;
+
+	// Derived from the shape parameters by CacheShapeData, so the shape tests never need trigonometry
+	float CosHalfFOV = 0.0f;
+	float TanHalfFOV = 0.0f;
+	float TanHalfVerticalFOV = 0.0f;
+
+	void CacheShapeData();
+	// Furthest distance from the eyes covered by the shape
+	float GetReach() const;
+};
+
 USTRUCT(BlueprintType)
 struct ADVANCEDSIGHT_API FAdvancedSightInfo
 {
@@ -16,11 +99,31 @@ struct ADVANCEDSIGHT_API FAdvancedSightInfo
 	float GainRadius = 1000.0f;
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	EAdvancedSightConeShape Shape = EAdvancedSightConeShape::Cone;
+
+	// Full angle of the cone, or the horizontal FOV of the frustum and ellipse shapes
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (EditCondition = "Shape != EAdvancedSightConeShape::Box"))
 	float FOV = 90.0f;
 
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly,
+		meta = (EditCondition = "Shape == EAdvancedSightConeShape::Frustum || Shape == EAdvancedSightConeShape::Ellipse"))
+	float VerticalFOV = 60.0f;
+
+	// Half of the width and height of the box, which is as deep as the gain radius
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (EditCondition = "Shape == EAdvancedSightConeShape::Box"))
+	FVector2D BoxHalfSize = FVector2D(200.0f, 100.0f);
+
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
 	float GainMultiplier = 1.0f;
 
+	// Scales the gain by the distance to the target divided by GainRadius. Uses the data asset curve when empty.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	FRuntimeFloatCurve DistanceGainCurve;
+
+	// Scales the gain by the angle to the target divided by half of the FOV. Uses the data asset curve when empty.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	FRuntimeFloatCurve AngleGainCurve;
+
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, AdvancedDisplay)
 	FColor DebugColor = FColor::Green;
 };
@@ -41,4 +144,47 @@ public:
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
 	FAISenseAffiliationFilter DetectionByAffiliation;
+
+	// Target categories listeners start subscribed to, targets without a target component are characters. Listeners
+	// can enable or disable categories at runtime with SetTargetCategoryEnabled.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (Bitmask, BitmaskEnum = "/Script/AdvancedSight.EAdvancedSightTargetCategory"))
+	int32 SubscribedCategories = static_cast<int32>(EAdvancedSightTargetCategory::Character);
+
+	// Scales the gain and the lose sight radius and cooldown of targets per category
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	TArray<FAdvancedSightCategoryTuning> CategoryTuning;
+
+	// Gain multiplier of targets in complete darkness, fully lit targets keep the unscaled gain. Only has an effect in
+	// levels with an illumination grid or light components.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (ClampMin = "0.0"))
+	float DarknessGainMultiplier = 0.25f;
+
+	// Noise events of loudness 1 are heard within this radius, zero disables hearing
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (ClampMin = "0.0"))
+	float HearingRadius = 0.0f;
+
+	// Targets within this radius are sensed regardless of sight, zero disables proximity
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (ClampMin = "0.0"))
+	float ProximityRadius = 0.0f;
+
+	// Default distance gain falloff for sight infos without their own curve
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	FRuntimeFloatCurve DistanceGainCurve;
+
+	// Default angle gain falloff for sight infos without their own curve
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	FRuntimeFloatCurve AngleGainCurve;
+
+	virtual void PostLoad() override;
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	void ConditionalBakeCones();
+	// Sight infos sorted by radius with their gain curves baked
+	const TArray<FAdvancedSightCone>& GetCones() const;
+protected:
+	void BakeCones();
+
+	TArray<FAdvancedSightCone> Cones;
 };
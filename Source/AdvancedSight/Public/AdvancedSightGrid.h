@@ -0,0 +1,33 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSightGrid.generated.h"
+
+// Uniform grid of cubic cells used by the baked level data, cells are stored x first, then y, then z
+USTRUCT()
+struct ADVANCEDSIGHT_API FAdvancedSightGridLayout
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere)
+	FVector Origin = FVector::ZeroVector;
+
+	UPROPERTY(VisibleAnywhere)
+	float CellSize = 0.0f;
+
+	UPROPERTY(VisibleAnywhere)
+	FIntVector Dimensions = FIntVector::ZeroValue;
+
+	static FAdvancedSightGridLayout MakeFromBounds(const FBox& Bounds, const float InCellSize);
+
+	bool IsValid() const;
+	int32 GetNumCells() const;
+	// Returns INDEX_NONE outside of the grid
+	int32 GetCellIndex(const FVector& Location) const;
+	FVector GetCellCenter(const int32 CellIndex) const;
+	FBox GetBounds() const;
+
+	friend FArchive& operator<<(FArchive& Ar, FAdvancedSightGridLayout& Layout);
+};
@@ -0,0 +1,28 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UAdvancedSightIlluminationGrid;
+
+struct FAdvancedSightLightVolume
+{
+	FVector Location = FVector::ZeroVector;
+	float RadiusSq = 0.0f;
+	float Illumination = 0.0f;
+};
+
+// Light level sources of the current sight update, gathered on the game thread and sampled by worker threads
+struct ADVANCEDSIGHT_API FAdvancedSightIllumination
+{
+	TArray<const UAdvancedSightIlluminationGrid*> Grids;
+	TArray<FAdvancedSightLightVolume> LightVolumes;
+
+	void Reset();
+	// Locations outside of every grid count as fully lit, so levels without a baked grid keep the unscaled gain
+	float Sample(const FVector& Location) const;
+
+	static uint8 Quantize(const float Illumination);
+	static float Dequantize(const uint8 QuantizedIllumination);
+};
@@ -0,0 +1,25 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "AdvancedSightIlluminationBakeCommandlet.generated.h"
+
+class AAdvancedSightIlluminationVolume;
+class UAdvancedSightIlluminationGrid;
+
+// Bakes the illumination grid of every illumination volume in a map from its light components, tracing from each cell
+// to the lights. Grids are created next to the map when a volume does not reference one yet.
+// Usage: -run=AdvancedSightIlluminationBake -Map=<map package name>
+UCLASS()
+class ADVANCEDSIGHT_API UAdvancedSightIlluminationBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UAdvancedSightIlluminationBakeCommandlet();
+	virtual int32 Main(const FString& Params) override;
+
+	static void BakeVolume(
+		const UWorld* World, const AAdvancedSightIlluminationVolume* Volume, UAdvancedSightIlluminationGrid* Grid);
+};
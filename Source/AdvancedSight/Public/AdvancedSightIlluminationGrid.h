@@ -0,0 +1,24 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSightGrid.h"
+#include "Engine/DataAsset.h"
+#include "AdvancedSightIlluminationGrid.generated.h"
+
+// Light level of a level baked by the AdvancedSightIlluminationBake commandlet, one byte per cell
+UCLASS()
+class ADVANCEDSIGHT_API UAdvancedSightIlluminationGrid : public UDataAsset
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(VisibleAnywhere, Category = "Illumination")
+	FAdvancedSightGridLayout Layout;
+
+	UPROPERTY()
+	TArray<uint8> Cells;
+
+	// Returns false outside of the grid
+	bool TrySample(const FVector& Location, float& OutIllumination) const;
+};
@@ -0,0 +1,39 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Volume.h"
+#include "AdvancedSightIlluminationVolume.generated.h"
+
+class UAdvancedSightIlluminationGrid;
+
+// Bounds and settings of the illumination grid baked for the level. The grid scales the gain of targets standing in it.
+UCLASS()
+class ADVANCEDSIGHT_API AAdvancedSightIlluminationVolume : public AVolume
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Illumination")
+	TObjectPtr<UAdvancedSightIlluminationGrid> IlluminationGrid;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Illumination|Bake", meta = (ClampMin = "10.0", Units = "cm"))
+	float CellSize = 200.0f;
+
+	// Illumination of cells no light reaches
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Illumination|Bake", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float AmbientIllumination = 0.05f;
+
+	// Illumination added by an unoccluded directional light, e.g. zero for night levels
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Illumination|Bake", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float DirectionalLightIllumination = 1.0f;
+
+	// Local light intensity, in the units of the light, at which a cell next to the light is fully lit
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Illumination|Bake", meta = (ClampMin = "0.0"))
+	float FullyLitIntensity = 5000.0f;
+
+	AAdvancedSightIlluminationVolume();
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+};
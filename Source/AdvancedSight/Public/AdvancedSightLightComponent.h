@@ -0,0 +1,40 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "AdvancedSightLightComponent.generated.h"
+
+class UAdvancedSightSystem;
+
+// Spherical light volume added on top of the baked illumination grid, meant for lights that move or are switched at
+// runtime. A negative illumination darkens the baked value, e.g. for a baked lamp that got shot out.
+UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class ADVANCEDSIGHT_API UAdvancedSightLightComponent : public USceneComponent
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Illumination", meta = (ClampMin = "0.0", Units = "cm"))
+	float Radius = 500.0f;
+
+	// Illumination at the center, fading out quadratically towards the radius
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Illumination", meta = (ClampMin = "-1.0", ClampMax = "1.0"))
+	float Illumination = 1.0f;
+
+	UAdvancedSightLightComponent();
+
+	UFUNCTION(BlueprintCallable, Category = "AdvancedSight")
+	void SetLightEnabled(const bool bEnabled);
+
+	UFUNCTION(BlueprintPure, Category = "AdvancedSight")
+	bool IsLightEnabled() const;
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	UPROPERTY(EditAnywhere, Category = "Illumination")
+	bool bIsLightEnabled = true;
+
+	TWeakObjectPtr<UAdvancedSightSystem> AdvancedSightSystem;
+};
@@ -0,0 +1,34 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "AdvancedSightOccluderComponent.generated.h"
+
+class UAdvancedSightSystem;
+
+// Lets sight rays pass through every primitive of the owner with the given transmittance when partial occlusion is
+// enabled, e.g. for a bush or a dirty window that does not have a dedicated physical material
+UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class ADVANCEDSIGHT_API UAdvancedSightOccluderComponent : public UActorComponent
+{
+	GENERATED_BODY()
+public:
+	UAdvancedSightOccluderComponent();
+
+	UFUNCTION(BlueprintCallable, Category = "AdvancedSight")
+	void SetTransmittance(const float InTransmittance);
+
+	UFUNCTION(BlueprintPure, Category = "AdvancedSight")
+	float GetTransmittance() const;
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Fraction of the sight gain left after a ray passes through, zero blocks sight completely
+	UPROPERTY(EditAnywhere, Category = "Occlusion", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float Transmittance = 0.5f;
+
+	TWeakObjectPtr<UAdvancedSightSystem> AdvancedSightSystem;
+};
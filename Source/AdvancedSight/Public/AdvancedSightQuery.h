@@ -0,0 +1,156 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSightData.h"
+#include "CollisionQueryParams.h"
+
+class UAdvancedSightComponent;
+
+enum class EAdvancedSightTransition : uint8
+{
+	None = 0,
+	Spotted = 1 << 0,
+	Perceived = 1 << 1,
+	Lost = 1 << 2,
+	Forgot = 1 << 3,
+};
+ENUM_CLASS_FLAGS(EAdvancedSightTransition);
+
+// Per pair state read and written by every visibility and state update. Everything else lives in the cold data or
+// in the listener profile, which keeps a record at 36 bytes.
+struct FAdvancedSightQuery
+{
+	static constexpr int32 MaxVisibilityPoints = 32;
+
+	uint32 ListenerId = UINT32_MAX;
+	uint32 TargetId = UINT32_MAX;
+	// Line of sight results of the current check, one bit per visibility point, so every cone shares a single trace
+	uint32 TracedPointsMask = 0;
+	uint32 ClearPointsMask = 0;
+	int32 bTargetVisibilityPointsFlag = 0;
+	float GainValue = 0.0f;
+	float CurrentGainMultiplier = 1.0f;
+	float LoseSightTimer = 0.0f;
+	uint8 bWasLastCheckSuccess : 1;
+	uint8 bIsCurrentCheckSuccess : 1;
+	uint8 bIsTargetPerceived : 1;
+	// Index of the lowest target category the listener subscribes to, selects the category tuning of the profile
+	uint8 CategoryIndex : 3;
+	// Set when the listener or target unregisters, the query is skipped until the next layout rebuild drops it
+	uint8 bIsRemoved : 1;
+	// Gain last reported to the listener component
+	uint8 QuantizedGain = 0;
+	// Light level at the visibility point the target was last seen at, scales the gain rate
+	uint8 Illumination = 255;
+	// Fraction of the sight left after the last clear ray passed through partially transparent geometry
+	uint8 Transmittance = 255;
+
+	FAdvancedSightQuery()
+		: bWasLastCheckSuccess(false)
+		, bIsCurrentCheckSuccess(false)
+		, bIsTargetPerceived(false)
+		, CategoryIndex(0)
+		, bIsRemoved(false)
+	{
+	}
+
+	// Pairs without any state would only fail the check while out of reach and leave everything untouched
+	bool HasState() const
+	{
+		return bWasLastCheckSuccess || bIsTargetPerceived || GainValue > 0.0f;
+	}
+};
+
+// Per pair data that is only written while the target is visible and read back outside of the update
+struct FAdvancedSightQueryColdData
+{
+	FVector LastSeenLocation = FVector::ZeroVector;
+	// Last seen location the listener was last told about
+	FVector ReportedLocation = FVector::ZeroVector;
+};
+
+// Cones of a single shape, tested together by the kernel specialized for it
+struct FAdvancedSightConeBatch
+{
+	EAdvancedSightConeShape Shape = EAdvancedSightConeShape::Cone;
+	// Range of the profile cone indices grouped by shape
+	int32 FirstIndex = 0;
+	int32 NumCones = 0;
+};
+
+struct FAdvancedSightCategoryProfile
+{
+	float GainMultiplier = 1.0f;
+	float LoseSightRadius = -1.0f;
+	float LoseSightCooldown = 1.0f;
+};
+
+// Sight data of a listener shared by all of its queries
+struct ADVANCEDSIGHT_API FAdvancedSightListenerProfile
+{
+	float LoseSightRadius = -1.0f;
+	float LoseSightCooldown = 1.0f;
+	float HearingRadius = 0.0f;
+	float ProximityRadius = 0.0f;
+	float DarknessGainMultiplier = 1.0f;
+	// Furthest distance any cone or the lose sight radius reaches
+	float BroadphaseRadius = 0.0f;
+	// Sorted by radius, the closest cone the target is visible in wins
+	TArray<FAdvancedSightCone> Cones;
+	TArray<uint8> ConeIndicesByShape;
+	TArray<FAdvancedSightConeBatch> ConeBatches;
+	FAdvancedSightCategoryProfile Categories[NumAdvancedSightTargetCategories];
+
+	void SetCones(const TArray<FAdvancedSightCone>& InCones);
+	void BuildConeBatches();
+	// Resolves the tuning against the lose sight radius and cooldown, which have to be set before
+	void SetCategoryTuning(const TArray<FAdvancedSightCategoryTuning>& CategoryTuning);
+	static uint8 GetCategoryIndex(const uint8 Categories);
+};
+
+// Queries of a listener are stored next to each other, starting at FirstQueryIndex
+struct FAdvancedSightListenerQueries
+{
+	int32 FirstQueryIndex = 0;
+	int32 NumQueries = 0;
+	// Listeners are spread over the stagger groups by this slot when the fixed update rate is used
+	uint8 StaggerSlot = 0;
+	FAdvancedSightListenerProfile Profile;
+	// Eyes the queries were last evaluated from, so debug output shows the pose the visibility pass used
+	FVector EvaluatedEyeLocation = FVector::ZeroVector;
+	FVector EvaluatedEyeForward = FVector::ForwardVector;
+	bool bHasEvaluatedEye = false;
+	// Targets of the queries with state, those stay gathered after the target leaves the cells in reach
+	TSet<uint32> StatefulTargets;
+};
+
+// Eyes of a listener snapshot on the game thread, so worker threads never touch the sight component or its body
+struct FAdvancedSightListenerEye
+{
+	FVector Location = FVector::ZeroVector;
+	FVector Forward = FVector::ForwardVector;
+	FCollisionQueryParams QueryParams;
+};
+
+struct FAdvancedSightActiveListener
+{
+	uint32 ListenerId = UINT32_MAX;
+	const UAdvancedSightComponent* SightComponent = nullptr;
+	const AActor* BodyActor = nullptr;
+	FVector BodyLocation = FVector::ZeroVector;
+	FAdvancedSightListenerEye Eye;
+	const FAdvancedSightListenerProfile* Profile = nullptr;
+	int32 FirstQueryIndex = 0;
+	int32 NumQueries = 0;
+	bool bIsInStaggerGroup = true;
+};
+
+struct FAdvancedSightTargetSnapshot
+{
+	const AActor* Actor = nullptr;
+	FVector Location = FVector::ZeroVector;
+	FIntPoint ShardCell = FIntPoint::ZeroValue;
+	TArray<FVector> VisibilityPoints;
+};
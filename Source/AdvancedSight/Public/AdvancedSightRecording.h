@@ -0,0 +1,153 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSightData.h"
+#include "AdvancedSightQuery.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+struct ADVANCEDSIGHT_API FAdvancedSightRecordedProfile : public FAdvancedSightListenerProfile
+{
+	uint32 ListenerId = UINT32_MAX;
+
+	friend FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedProfile& Profile);
+};
+
+struct ADVANCEDSIGHT_API FAdvancedSightRecordedListener
+{
+	uint32 ListenerId = UINT32_MAX;
+	FVector EyeLocation = FVector::ZeroVector;
+	FVector EyeForward = FVector::ForwardVector;
+
+	friend FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedListener& Listener);
+};
+
+struct ADVANCEDSIGHT_API FAdvancedSightRecordedTarget
+{
+	uint32 TargetId = UINT32_MAX;
+	FVector Location = FVector::ZeroVector;
+	TArray<FVector> VisibilityPoints;
+
+	friend FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedTarget& Target);
+};
+
+struct ADVANCEDSIGHT_API FAdvancedSightRecordedQuery
+{
+	uint32 ListenerId = UINT32_MAX;
+	uint32 TargetId = UINT32_MAX;
+	uint32 TracedPointsMask = 0;
+	uint32 ClearPointsMask = 0;
+	uint8 Illumination = 255;
+	uint8 Transmittance = 255;
+	uint8 CategoryIndex = 0;
+
+	friend FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedQuery& Query);
+};
+
+// Perception state of a query when the recording started, so recordings started mid-session replay from it
+struct ADVANCEDSIGHT_API FAdvancedSightRecordedQueryState
+{
+	uint32 ListenerId = UINT32_MAX;
+	uint32 TargetId = UINT32_MAX;
+	float GainValue = 0.0f;
+	float LoseSightTimer = 0.0f;
+	bool bWasLastCheckSuccess = false;
+	bool bIsTargetPerceived = false;
+	uint8 CategoryIndex = 0;
+
+	friend FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedQueryState& State);
+};
+
+// Query removed because the listener or the target changed its categories, the state of the pair starts over
+struct ADVANCEDSIGHT_API FAdvancedSightRecordedQueryRemoval
+{
+	uint32 ListenerId = UINT32_MAX;
+	uint32 TargetId = UINT32_MAX;
+
+	friend FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedQueryRemoval& Removal);
+};
+
+struct ADVANCEDSIGHT_API FAdvancedSightRecordedTransition
+{
+	uint32 ListenerId = UINT32_MAX;
+	uint32 TargetId = UINT32_MAX;
+	EAdvancedSightTransition Transitions = EAdvancedSightTransition::None;
+
+	bool operator==(const FAdvancedSightRecordedTransition& Other) const;
+	friend FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedTransition& Transition);
+};
+
+// Everything the visibility and state update passes consumed during a single tick. Profiles are only written the
+// first time a listener shows up in the recording, and dormant listeners are not written at all. The first frame also
+// carries the state of every query at the time the recording started.
+struct ADVANCEDSIGHT_API FAdvancedSightRecordedFrame
+{
+	float DeltaTime = 0.0f;
+	TArray<FAdvancedSightRecordedQueryState> InitialQueryStates;
+	TArray<uint32> RemovedListeners;
+	TArray<uint32> RemovedTargets;
+	TArray<FAdvancedSightRecordedQueryRemoval> RemovedQueries;
+	TArray<FAdvancedSightRecordedProfile> NewProfiles;
+	TArray<FAdvancedSightRecordedListener> Listeners;
+	TArray<FAdvancedSightRecordedTarget> Targets;
+	TArray<FAdvancedSightRecordedQuery> Queries;
+	TArray<FAdvancedSightRecordedTransition> Transitions;
+
+	void Reset();
+	friend FArchive& operator<<(FArchive& Ar, FAdvancedSightRecordedFrame& Frame);
+};
+
+class ADVANCEDSIGHT_API FAdvancedSightRecorder
+{
+public:
+	~FAdvancedSightRecorder();
+
+	bool Open(const FString& InFilePath);
+	void Close();
+	bool IsProfileRecorded(const uint32 ListenerId) const;
+	void WriteFrame(FAdvancedSightRecordedFrame& Frame);
+	const FString& GetFilePath() const;
+	int32 GetNumFrames() const;
+private:
+	TUniquePtr<FArchive> FileWriter;
+	TSet<uint32> RecordedProfiles;
+	TArray<uint8> FrameBuffer;
+	FString FilePath;
+	int32 NumFrames = 0;
+};
+
+struct ADVANCEDSIGHT_API FAdvancedSightReplayResult
+{
+	int32 NumFrames = 0;
+	int64 NumQueryEvaluations = 0;
+	int32 NumTransitions = 0;
+	int32 NumMismatchedFrames = 0;
+	int32 FirstMismatchedFrame = INDEX_NONE;
+	double VisibilitySeconds = 0.0;
+	double StateSeconds = 0.0;
+	TArray<FString> TransitionLog;
+};
+
+// Feeds a recording back through the visibility and state update passes without a world, using the recorded line of
+// sight results instead of physics traces, and compares the resulting transitions against the recorded ones.
+class ADVANCEDSIGHT_API FAdvancedSightReplayPlayer
+{
+public:
+	~FAdvancedSightReplayPlayer();
+
+	bool Open(const FString& FilePath);
+	void Close();
+	bool ReadNextFrame(FAdvancedSightRecordedFrame& OutFrame);
+	FAdvancedSightReplayResult Run(const bool bSingleThreaded, const bool bCollectTransitionLog);
+private:
+	static uint64 MakeQueryKey(const uint32 ListenerId, const uint32 TargetId);
+
+	TUniquePtr<IMappedFileHandle> MappedFileHandle;
+	TUniquePtr<IMappedFileRegion> MappedFileRegion;
+	TUniquePtr<FArchive> Reader;
+	TMap<uint32, FAdvancedSightRecordedProfile> Profiles;
+	TMap<uint64, FAdvancedSightQuery> QueryStates;
+};
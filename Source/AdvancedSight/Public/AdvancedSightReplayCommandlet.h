@@ -0,0 +1,18 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "AdvancedSightReplayCommandlet.generated.h"
+
+// Replays a sight recording headlessly and reports timings and transition mismatches.
+// Usage: -run=AdvancedSightReplay -File=<recording> [-Iterations=N] [-SingleThreaded] [-TransitionsOutput=<file>]
+UCLASS()
+class ADVANCEDSIGHT_API UAdvancedSightReplayCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UAdvancedSightReplayCommandlet();
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,89 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "AdvancedSightReplication.generated.h"
+
+class UAdvancedSightReplicationComponent;
+
+UENUM(meta = (Bitflags, UseEnumValuesAsMaskValuesInEditor = "true"))
+enum class EAdvancedSightTargetState : uint8
+{
+	None = 0,
+	Spotted = 1 << 0,
+	Perceived = 1 << 1,
+	Remembered = 1 << 2,
+};
+ENUM_CLASS_FLAGS(EAdvancedSightTargetState);
+
+struct FAdvancedSightReplicatedTargets;
+
+USTRUCT()
+struct ADVANCEDSIGHT_API FAdvancedSightReplicatedTarget : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TObjectPtr<AActor> TargetActor;
+
+	UPROPERTY()
+	EAdvancedSightTargetState State = EAdvancedSightTargetState::None;
+
+	UPROPERTY()
+	uint8 QuantizedGain = 0;
+
+	// Client side copies of the last applied values, so changes can be turned back into transitions
+	TWeakObjectPtr<AActor> AppliedTargetActor;
+	EAdvancedSightTargetState AppliedState = EAdvancedSightTargetState::None;
+	uint8 AppliedQuantizedGain = 0;
+
+	void PreReplicatedRemove(const FAdvancedSightReplicatedTargets& InArraySerializer);
+	void PostReplicatedAdd(const FAdvancedSightReplicatedTargets& InArraySerializer);
+	void PostReplicatedChange(const FAdvancedSightReplicatedTargets& InArraySerializer);
+
+	static uint8 QuantizeGain(const float GainValue);
+	static float DequantizeGain(const uint8 QuantizedGain);
+};
+
+// Spotted, perceived and remembered targets of a single listener together with their gain. Only targets with a state
+// or some gain have an item and only changed items are sent.
+USTRUCT()
+struct ADVANCEDSIGHT_API FAdvancedSightReplicatedTargets : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FAdvancedSightReplicatedTarget> Items;
+
+	UPROPERTY(NotReplicated)
+	TObjectPtr<UAdvancedSightReplicationComponent> Owner;
+
+	FAdvancedSightReplicatedTargets() = default;
+	explicit FAdvancedSightReplicatedTargets(UAdvancedSightReplicationComponent* InOwner)
+		: Owner(InOwner)
+	{
+	}
+
+	FAdvancedSightReplicatedTarget* FindItem(const AActor* TargetActor);
+	const FAdvancedSightReplicatedTarget* FindItem(const AActor* TargetActor) const;
+	// Both return true when the array changed
+	bool SetItem(AActor* TargetActor, const EAdvancedSightTargetState State, const uint8 QuantizedGain);
+	bool RemoveItem(const AActor* TargetActor);
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParams)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FAdvancedSightReplicatedTarget, FAdvancedSightReplicatedTargets>(
+			Items, DeltaParams, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FAdvancedSightReplicatedTargets> : public TStructOpsTypeTraitsBase2<FAdvancedSightReplicatedTargets>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
@@ -0,0 +1,77 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSightComponent.h"
+#include "AdvancedSightReplication.h"
+#include "Components/ActorComponent.h"
+#include "AdvancedSightReplicationComponent.generated.h"
+
+// Carries the perception state of a sight component on its body. The sight component usually lives on an AI
+// controller, which is never sent to other clients, while the pawn is relevant to every client that can see it.
+// Added by sight components with replication enabled, clients rebuild the target lists and broadcast the delegates.
+UCLASS(ClassGroup=(AI))
+class ADVANCEDSIGHT_API UAdvancedSightReplicationComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UAdvancedSightReplicationComponent();
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	// Authority only, both keep the other half of the replicated item
+	void SetTargetState(AActor* TargetActor, const EAdvancedSightTargetState State);
+	void SetQuantizedGain(AActor* TargetActor, const uint8 QuantizedGain);
+	void SetTarget(AActor* TargetActor, const EAdvancedSightTargetState State, const uint8 QuantizedGain);
+	// Authority only, used when the sight component stops driving this body
+	void ResetTargets();
+
+	UFUNCTION(BlueprintPure)
+	float GetGainValueForTarget(const AActor* TargetActor) const;
+
+	EAdvancedSightTargetState GetTargetState(const AActor* TargetActor) const;
+
+	// Target lists are only rebuilt on clients, the authority reads them from the sight component
+	UFUNCTION(BlueprintCallable)
+	const TArray<AActor*>& GetPerceivedTargets() const;
+
+	UFUNCTION(BlueprintCallable)
+	const TArray<AActor*>& GetSpottedTargets() const;
+
+	UFUNCTION(BlueprintCallable)
+	const TArray<AActor*>& GetRememberedTargets() const;
+
+	// Called by the replicated target items on clients to turn state changes back into the target lists and delegates
+	void ApplyReplicatedTarget(FAdvancedSightReplicatedTarget& Item, const bool bIsRemoved);
+
+	UPROPERTY(BlueprintAssignable)
+	FAdvancedSightComponentDelegate OnTargetSpotted;
+
+	UPROPERTY(BlueprintAssignable)
+	FAdvancedSightComponentDelegate OnTargetPerceived;
+
+	UPROPERTY(BlueprintAssignable)
+	FAdvancedSightComponentDelegate OnTargetLost;
+
+	UPROPERTY(BlueprintAssignable)
+	FAdvancedSightComponentDelegate OnTargetForgot;
+
+	FAdvancedSightTransitionNativeDelegate OnTargetTransition;
+	FAdvancedSightGainNativeDelegate OnTargetGainChanged;
+protected:
+	void ApplyTargetState(
+		AActor* TargetActor, const EAdvancedSightTargetState OldState, const EAdvancedSightTargetState NewState);
+
+	UPROPERTY(Replicated)
+	FAdvancedSightReplicatedTargets ReplicatedTargets;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AActor>> PerceivedTargets;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AActor>> SpottedTargets;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AActor>> RememberedTargets;
+};
@@ -6,6 +6,8 @@
 #include "Engine/DeveloperSettings.h"
 #include "AdvancedSightSettings.generated.h"
 
+class UPhysicalMaterial;
+
 USTRUCT(BlueprintType)
 struct ADVANCEDSIGHT_API FDebugDrawInfo
 {
@@ -34,6 +36,27 @@ struct ADVANCEDSIGHT_API FDebugDrawInfo
 
 	UPROPERTY(EditDefaultsOnly)
 	int32 VisibilityPointSphereSegments = 8;
+
+	// Listeners within this distance from the gameplay debugger actor are listed by the AdvancedSight category
+	UPROPERTY(EditDefaultsOnly)
+	float GameplayDebuggerRadius = 5000.0f;
+
+	// Only the closest listeners get their cones and visibility points drawn, the rest are only listed
+	UPROPERTY(EditDefaultsOnly)
+	int32 GameplayDebuggerMaxDrawnListeners = 8;
+};
+
+USTRUCT(BlueprintType)
+struct ADVANCEDSIGHT_API FAdvancedSightMaterialTransmittance
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditDefaultsOnly)
+	TSoftObjectPtr<UPhysicalMaterial> PhysicalMaterial;
+
+	// Fraction of the sight gain left after a ray passes through, zero blocks sight completely
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float Transmittance = 0.5f;
 };
 
 UCLASS(Config=Game, DefaultConfig)
@@ -44,6 +67,64 @@ public:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "General")
 	TEnumAsByte<ECollisionChannel> AdvancedSightCollisionChannel = ECC_WorldStatic;
 
+	// A visible target has to move this far from the location last reported to the listener before it is reported again
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "General", meta = (ClampMin = "0.0", Units = "cm"))
+	float LastSeenLocationReportDistance = 100.0f;
+
+	// Integrates sight at a fixed rate instead of once per frame, so its cost and timing do not depend on the frame rate
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Update")
+	bool bUseFixedUpdateRate = false;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Update", meta = (EditCondition = "bUseFixedUpdateRate", ClampMin = "1.0", Units = "Hz"))
+	float FixedUpdateRate = 20.0f;
+
+	// Time beyond this many substeps in a single frame is dropped
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Update", meta = (EditCondition = "bUseFixedUpdateRate", ClampMin = "1"))
+	int32 MaxSubstepsPerFrame = 4;
+
+	// Listeners are split into this many groups and each substep only updates one of them
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Update", meta = (EditCondition = "bUseFixedUpdateRate", ClampMin = "1", ClampMax = "16"))
+	int32 NumStaggerGroups = 1;
+
+	// Listeners and targets are bucketed into square shards of this size, gathered as independent tasks. Pairs of
+	// targets out of reach of the listener and without any perception state are skipped. Matching the World Partition
+	// cell size keeps shards aligned with streaming.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Update", meta = (ClampMin = "1000.0", Units = "cm"))
+	float ShardCellSize = 12800.0f;
+
+	// Dormant listeners keep their memory but stop generating queries until their significance rises again. Opt-in, as
+	// dormant listeners get no transitions and keep their gain frozen.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Dormancy")
+	bool bEnableListenerDormancy = false;
+
+	// Distance to the nearest player pawn at which the default significance function drops to zero
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Dormancy", meta = (EditCondition = "bEnableListenerDormancy", ClampMin = "0.0"))
+	float DormancyDistance = 15000.0f;
+
+	// Listeners whose significance is at or below this value become dormant
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Dormancy", meta = (EditCondition = "bEnableListenerDormancy"))
+	float DormancySignificanceThreshold = 0.0f;
+
+	// Sight rays pass through hits with a transmittance from the material table or an occluder component and the gain
+	// is scaled by what is left of it. Foliage and glass have to block or overlap the sight channel for it to apply.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Occlusion")
+	bool bEnablePartialOcclusion = false;
+
+	// Rays passing through more partially transparent hits than this are treated as occluded
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Occlusion", meta = (EditCondition = "bEnablePartialOcclusion", ClampMin = "1", ClampMax = "16"))
+	int32 MaxOcclusionHits = 4;
+
+	// Rays with less transmittance left than this are treated as occluded
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Occlusion", meta = (EditCondition = "bEnablePartialOcclusion", ClampMin = "0.01", ClampMax = "1.0"))
+	float MinTransmittance = 0.1f;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Occlusion", meta = (EditCondition = "bEnablePartialOcclusion"))
+	TArray<FAdvancedSightMaterialTransmittance> MaterialTransmittance;
+
+	// Records of a restored perception state whose listeners or targets do not register within this time are dropped
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Persistence", meta = (ClampMin = "0.0", Units = "s"))
+	float PendingSnapshotTimeout = 60.0f;
+
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Debug")
 	FDebugDrawInfo DebugDrawInfo;
 };
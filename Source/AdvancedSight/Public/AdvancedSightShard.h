@@ -0,0 +1,48 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Listeners and targets of a single spatial cell in the current update
+struct FAdvancedSightShard
+{
+	TArray<uint32> TargetIds;
+	// Indices into the active listeners of the update
+	TArray<int32> ListenerIndices;
+	// Active queries of the shard listeners, gathered by the shard task
+	TArray<int32> QueryIndices;
+	TArray<int32> QueryListenerIndices;
+	// Scratch of the shard task, targets of the cells in reach of the listener it gathers
+	TArray<uint32> CandidateTargetIds;
+
+	bool IsEmpty() const;
+	void Reset();
+};
+
+// Sparse square grid of shards rebuilt every update. A shard only exists while something is inside of its cell, so
+// memory follows the loaded content and is released as soon as a cell is left or streamed out. Every shard gathers the
+// queries of its listeners from the targets of the shards in reach, the gathered queries are evaluated as a single flat
+// list.
+class ADVANCEDSIGHT_API FAdvancedSightShardGrid
+{
+public:
+	void Reset(const float InCellSize);
+	FIntPoint GetCell(const FVector& Location) const;
+	void GetCellRange(const FVector& Location, const float Radius, FIntPoint& OutMinCell, FIntPoint& OutMaxCell) const;
+	static bool IsCellInRange(const FIntPoint& Cell, const FIntPoint& MinCell, const FIntPoint& MaxCell);
+	void AddTarget(const FIntPoint& Cell, const uint32 TargetId);
+	void AddListener(const FIntPoint& Cell, const int32 ListenerIndex);
+	// Drops the shards that stayed empty since the last reset and indexes the remaining ones
+	void FinishBuild();
+	// Targets of every shard overlapping the radius, the caller does the exact distance check
+	void GatherTargetIds(const FVector& Location, const float Radius, TArray<uint32>& OutTargetIds) const;
+
+	int32 Num() const;
+	FAdvancedSightShard& GetShard(const int32 Index);
+	const FAdvancedSightShard& GetShard(const int32 Index) const;
+private:
+	TMap<FIntPoint, FAdvancedSightShard> Shards;
+	TArray<FAdvancedSightShard*> ShardList;
+	float CellSize = 12800.0f;
+};
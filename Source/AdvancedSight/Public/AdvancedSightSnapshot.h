@@ -0,0 +1,51 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct ADVANCEDSIGHT_API FAdvancedSightPersistentQuery
+{
+	enum EFlags : uint8
+	{
+		WasLastCheckSuccess = 1 << 0,
+		IsTargetPerceived = 1 << 1,
+	};
+
+	int32 ListenerIndex = INDEX_NONE;
+	int32 TargetIndex = INDEX_NONE;
+	uint8 Flags = 0;
+	float GainValue = 0.0f;
+	float LoseSightTimer = 0.0f;
+	FVector LastSeenLocation = FVector::ZeroVector;
+
+	friend FArchive& operator<<(FArchive& Ar, FAdvancedSightPersistentQuery& Query);
+};
+
+struct ADVANCEDSIGHT_API FAdvancedSightPersistentListener
+{
+	int32 ListenerIndex = INDEX_NONE;
+	TArray<int32> PerceivedTargets;
+	TArray<int32> SpottedTargets;
+	TArray<int32> RememberedTargets;
+
+	friend FArchive& operator<<(FArchive& Ar, FAdvancedSightPersistentListener& Listener);
+};
+
+// Perception state of a sight system keyed by persistent actor identifiers. Every identifier is stored once and
+// referenced by index from the query and listener records. Identifiers are actor path names, which are only stable for
+// actors placed in a level; records of actors spawned at runtime do not resolve once those actors are spawned again.
+struct ADVANCEDSIGHT_API FAdvancedSightPerceptionSnapshot
+{
+	static constexpr uint32 Magic = 0x53505341; // "ASPS"
+	static constexpr uint32 Version = 1;
+
+	TArray<FString> Ids;
+	TArray<FAdvancedSightPersistentQuery> Queries;
+	TArray<FAdvancedSightPersistentListener> Listeners;
+
+	bool IsEmpty() const;
+	void Reset();
+	// Returns false when the data is not a snapshot of the current version
+	bool Serialize(FArchive& Ar);
+};
@@ -3,61 +3,254 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "AdvancedSense.h"
 #include "AdvancedSightData.h"
+#include "AdvancedSightIllumination.h"
+#include "AdvancedSightQuery.h"
+#include "AdvancedSightRecording.h"
+#include "AdvancedSightShard.h"
+#include "AdvancedSightSnapshot.h"
+#include "AdvancedSightTransmittance.h"
+#include "AdvancedSightVisibilitySet.h"
+#include "Async/Future.h"
 #include "Subsystems/WorldSubsystem.h"
 #include "AdvancedSightSystem.generated.h"
 
 struct FSightSpatialInfo;
 class AActor;
 class UAdvancedSightComponent;
+class UAdvancedSightIlluminationGrid;
+class UAdvancedSightLightComponent;
+class UAdvancedSightOccluderComponent;
+class UPrimitiveComponent;
+class FAdvancedSenseHearing;
 
-struct FAdvancedSightQuery
+struct FAdvancedSightTargetDebugInfo
 {
-	uint32 ListenerId = UINT32_MAX;
 	uint32 TargetId = UINT32_MAX;
-	FVector LastSeenLocation;
-	int32 bWasLastCheckSuccess : 1;
-	int32 bIsCurrentCheckSuccess : 1;
-	int32 bIsTargetPerceived : 1;
-	int32 bTargetVisibilityPointsFlag = 0;
-	float LoseSightTimer = 0.0f;
-	float LoseSightCooldown = 1.0f;
+	FVector Location = FVector::ZeroVector;
+	FVector LastSeenLocation = FVector::ZeroVector;
 	float GainValue = 0.0f;
-	float CurrentGainMultiplier = 1.0f;
+	bool bIsVisible = false;
+	bool bIsPerceived = false;
+	int32 VisibilityPointsFlags = 0;
+	TArray<FVector> VisibilityPoints;
+};
+
+struct FAdvancedSightListenerDebugInfo
+{
+	uint32 ListenerId = UINT32_MAX;
+	FString Name;
+	FVector EyeLocation = FVector::ZeroVector;
+	FVector EyeForward = FVector::ForwardVector;
+	bool bIsDormant = false;
+	int32 NumQueries = 0;
 	float LoseSightRadius = -1.0f;
-	TArray<FAdvancedSightInfo> SightInfos;
+	TArray<FAdvancedSightCone> Cones;
+	// Only targets that are spotted, perceived or still have gain
+	TArray<FAdvancedSightTargetDebugInfo> Targets;
+};
+
+struct FAdvancedSightVisibilityResult
+{
+	bool bIsVisible = false;
+	// Gain multiplier of the closest cone the target is visible in
+	float GainMultiplier = 0.0f;
+	int32 VisibilityPointsFlags = 0;
+};
+
+// World data of the current sight update that worker threads read while evaluating visibility
+struct FAdvancedSightWorldContext
+{
+	const UWorld* World = nullptr;
+	ECollisionChannel CollisionChannel = ECC_WorldStatic;
+	const FAdvancedSightIllumination* Illumination = nullptr;
+	TConstArrayView<const FAdvancedSightVisibilitySet*> VisibilitySets;
+	// Only set when partial occlusion is enabled, rays are traced with a single blocking trace otherwise
+	const FAdvancedSightTransmittanceTable* TransmittanceTable = nullptr;
+	int32 MaxOcclusionHits = 0;
+	float MinTransmittance = 0.0f;
+};
+
+DECLARE_DELEGATE_OneParam(FAdvancedSightVisibilityDelegate, const FAdvancedSightVisibilityResult& /* Result */);
+
+struct FAdvancedSightVisibilityRequest
+{
+	TWeakObjectPtr<const UAdvancedSightComponent> SightComponent;
+	TWeakObjectPtr<const AActor> TargetActor;
+	bool bHasTargetActor = false;
+	FVector TargetPoint = FVector::ZeroVector;
+	TWeakObjectPtr<UAdvancedSightData> SightData;
+	TFunction<void(const FAdvancedSightVisibilityResult&)> OnCompleted;
+
+	// Resolved on the game thread right before the visibility pass so worker threads never touch the weak pointers
+	const UAdvancedSightComponent* ResolvedSightComponent = nullptr;
+	const AActor* ResolvedTargetActor = nullptr;
+	FAdvancedSightListenerEye Eye;
+	TArray<FVector> VisibilityPoints;
+	FAdvancedSightListenerProfile Profile;
+	FAdvancedSightQuery Query;
 };
 
 UCLASS()
 class ADVANCEDSIGHT_API UAdvancedSightSystem : public UTickableWorldSubsystem
 {
 	GENERATED_BODY()
+	friend struct FAdvancedSightSystemTestAccess;
 public:
+	using FSignificanceFunction = TFunction<float(const UAdvancedSightComponent* SightComponent)>;
+	// Returns the fraction of sight left on the line from the listener eyes to the visibility point, zero when blocked
+	using FLineOfSightFunction = TFunctionRef<float(int32 PointIndex)>;
+	// Returns the light level at the visibility point, from zero in complete darkness to one when fully lit
+	using FIlluminationFunction = TFunctionRef<float(int32 PointIndex)>;
+
 	void RegisterListener(UAdvancedSightComponent* SightComponent);
 	void UnregisterListener(UAdvancedSightComponent* SightComponent);
 	void RegisterTarget(AActor* TargetActor);
 	void UnregisterTarget(AActor* TargetActor);
+	void RegisterIlluminationGrid(const UAdvancedSightIlluminationGrid* IlluminationGrid);
+	void UnregisterIlluminationGrid(const UAdvancedSightIlluminationGrid* IlluminationGrid);
+	void RegisterLight(const UAdvancedSightLightComponent* LightComponent);
+	void UnregisterLight(const UAdvancedSightLightComponent* LightComponent);
+	// Adds or refreshes the transmittance of every primitive of the occluder owner
+	void RegisterOccluder(const UAdvancedSightOccluderComponent* OccluderComponent);
+	void UnregisterOccluder(const UAdvancedSightOccluderComponent* OccluderComponent);
+	// Memory maps the potentially visible set baked for the level, returns false when there is none
+	bool LoadVisibilitySet(const FString& LevelPackageName);
+	void UnloadVisibilitySet(const FString& LevelPackageName);
+	// Resynchronize the queries of a single listener or target with its categories before the next update. Pairs that
+	// lose their subscription are removed and the listener forgets the target.
+	void UpdateListenerCategories(const UAdvancedSightComponent* SightComponent);
+	void UpdateTargetCategories(const AActor* TargetActor);
 	float GetGainValueForTarget(const uint32 Listener, const uint32 TargetId) const;
 	FVector GetLastKnownLocationFor(const uint32 ListenerId, const uint32 TargetId) const;
 
+	// Replaces the default significance function (distance to the nearest player pawn). Pass nullptr to restore it.
+	void SetSignificanceFunction(FSignificanceFunction InSignificanceFunction);
+	bool IsListenerDormant(const uint32 ListenerId) const;
+	int32 GetNumDormantListeners() const;
+
+	bool StartRecording(const FString& FilePath);
+	void StopRecording();
+	bool IsRecording() const;
+
+	// One-off checks whether the listener can see the target with the given sight data, or its own when null. They are
+	// evaluated together with the regular queries on the next sight system tick, which is the current frame when issued
+	// before it, and completed on the game thread.
+	void RequestVisibility(
+		const UAdvancedSightComponent* SightComponent,
+		const AActor* TargetActor,
+		UAdvancedSightData* SightData,
+		FAdvancedSightVisibilityDelegate OnCompleted);
+	void RequestVisibility(
+		const UAdvancedSightComponent* SightComponent,
+		const FVector& TargetPoint,
+		UAdvancedSightData* SightData,
+		FAdvancedSightVisibilityDelegate OnCompleted);
+	TFuture<FAdvancedSightVisibilityResult> RequestVisibilityAsync(
+		const UAdvancedSightComponent* SightComponent, const AActor* TargetActor, UAdvancedSightData* SightData = nullptr);
+	TFuture<FAdvancedSightVisibilityResult> RequestVisibilityAsync(
+		const UAdvancedSightComponent* SightComponent, const FVector& TargetPoint, UAdvancedSightData* SightData = nullptr);
+
+	// Writes the perception state of every query and listener keyed by persistent actor identifiers
+	UFUNCTION(BlueprintCallable, Category = "AdvancedSight")
+	void SavePerceptionState(TArray<uint8>& OutData) const;
+
+	// Restores a saved perception state in a single pass. Records of listeners or targets that are not registered yet,
+	// e.g. because their level is still streaming in, are kept and applied once they register, until the pending
+	// snapshot timeout runs out or another state is restored.
+	UFUNCTION(BlueprintCallable, Category = "AdvancedSight")
+	bool RestorePerceptionState(const TArray<uint8>& Data);
+
+	static FString GetPersistentId(const AActor* Actor);
+
+	// Plugs an additional sense into the sight system update, hearing and proximity are always present
+	void AddSense(TSharedRef<FAdvancedSenseBase> Sense);
+
+	// Heard by listeners within their hearing radius scaled by the loudness, and never further than MaxRange when set
+	UFUNCTION(BlueprintCallable, Category = "AdvancedSight")
+	void ReportNoiseEvent(const FVector& Location, float Loudness, AActor* Instigator, float MaxRange = 0.0f);
+
+	// Builds debug info of every listener within the radius from the state of the last tick in a single pass
+	void GatherDebugInfo(
+		const FVector& Origin, const float Radius, TArray<FAdvancedSightListenerDebugInfo>& OutListeners) const;
+
+	static void EvaluateQueryVisibility(
+		FAdvancedSightQuery& Query,
+		const FAdvancedSightListenerProfile& Profile,
+		const FVector& EyeLocation,
+		const FVector& EyeForward,
+		TConstArrayView<FVector> VisibilityPoints,
+		FLineOfSightFunction LineOfSightFunction,
+		FIlluminationFunction IlluminationFunction);
+	// Only touches the hot query data, the caller updates the last seen location while the check succeeds
+	static EAdvancedSightTransition UpdateQueryState(
+		FAdvancedSightQuery& Query, const FAdvancedSightListenerProfile& Profile, const float DeltaTime);
+
 	virtual void PostInitProperties() override;
+	virtual void Deinitialize() override;
 	virtual void Tick(float DeltaTime) override;
 	virtual TStatId GetStatId() const override;
 protected:
 	void HandleNewActorSpawned(AActor* Actor);
+	void UpdateListenersDormancy();
+	bool ShouldListenerBeDormant(const UAdvancedSightComponent* SightComponent) const;
+	float CalculateDefaultSignificance(const UAdvancedSightComponent* SightComponent) const;
+	void GatherTargetSnapshots();
+	void GatherIllumination();
+	int32 UpdateSight(const float DeltaTime, const int32 StaggerGroup, const bool bUpdateQueries);
+	void GatherActiveListeners(const int32 StaggerGroup);
+	void BuildShards();
+	void GatherActiveQueries();
+	void ConditionalRebuildQueryLayout();
+	void RemoveQueries(TFunctionRef<bool(const FAdvancedSightQuery& Query)> Predicate);
+	// Unregistering can happen from perception delegates while the active queries are dispatched, so the queries are
+	// only marked and the arrays keep their layout until the next rebuild
+	void TombstoneQueries(TFunctionRef<bool(const FAdvancedSightQuery& Query)> Predicate);
+	void ApplyPendingCategoryChanges();
+	void ApplyListenerCategories(const UAdvancedSightComponent* SightComponent);
+	void ApplyTargetCategories(const AActor* TargetActor);
+	void RemoveUnsubscribedQueries(TFunctionRef<bool(const FAdvancedSightQuery& Query)> Predicate);
+	static uint8 GetTargetCategories(const AActor* TargetActor);
+	int32 FindQueryIndex(const uint32 ListenerId, const uint32 TargetId) const;
+	// Binary search over the queries of a listener, only valid while the layout is not dirty
+	int32 FindListenerQueryIndex(const int32 FirstQueryIndex, const int32 NumQueries, const uint32 TargetId) const;
+	void UpdateStatefulTarget(const FAdvancedSightQuery& Query);
+	void DispatchTransitions(const uint32 ListenerId, const uint32 TargetId, const EAdvancedSightTransition Transitions);
+	void RecordFrame(const float DeltaTime);
+	void DispatchSenseEvents();
+	void PrepareVisibilityRequests();
+	void ApplyPerceptionSnapshot(FAdvancedSightPerceptionSnapshot& Snapshot);
+	void CompleteVisibilityRequests();
+	static void SnapshotListenerEye(const UAdvancedSightComponent* SightComponent, FAdvancedSightListenerEye& OutEye);
+	// Eyes of the last evaluation of the listener, or its current eyes when it has not been evaluated yet
+	void GetEvaluatedEye(
+		const UAdvancedSightComponent* SightComponent, FVector& OutLocation, FVector& OutForward) const;
+	static void EvaluateVisibility(
+		FAdvancedSightQuery& Query,
+		const FAdvancedSightListenerProfile& Profile,
+		const FAdvancedSightListenerEye& Eye,
+		TConstArrayView<FVector> VisibilityPoints,
+		const AActor* TargetActor,
+		const FAdvancedSightWorldContext& WorldContext);
 	void AddQuery(
 		const UAdvancedSightComponent* SightComponent, const AActor* TargetActor, const UAdvancedSightData* SightData);
-	static bool IsVisibleInsideCone(
-		const UAdvancedSightComponent* SourceComponent,
-		const AActor* TargetActor,
-		const float Radius,
-		const float FOV,
-		ECollisionChannel CollisionChannel,
-		int32& VisibilityPointsFlags);
+	// Returns the first point of the mask with a line of sight
+	static int32 FindVisiblePoint(FAdvancedSightQuery& Query, uint32 PointsMask, FLineOfSightFunction LineOfSightFunction);
+	static float SampleGainTable(
+		const FAdvancedSightCone& Cone, const FVector& EyeLocation, const FVector& EyeForward, const FVector& Point);
+	static bool HasLineOfSight(FAdvancedSightQuery& Query, const int32 PointIndex, FLineOfSightFunction LineOfSightFunction);
 	static void SetPointVisible(int32& Flags, int32 PointIndex, bool bIsVisible);
 	static bool IsPointVisible(int32 Flags, int32 PointIndex);
 	static void ResetPointsVisibility(int32& Flags);
 	static void GetVisibilityPointsForActor(const AActor* Actor, TArray<FVector>& OutVisibilityPoints);
+	// Multi hit trace accumulating the transmittance of everything the ray passes through before reaching the end
+	static float TraceTransmittance(
+		const FAdvancedSightWorldContext& WorldContext,
+		const FCollisionQueryParams& QueryParams,
+		const FVector& Start,
+		const FVector& End,
+		const AActor* TargetActor);
 
 	void OnDebugDrawStateChanged(IConsoleVariable* ConsoleVariable);
 
@@ -65,7 +258,56 @@ protected:
 
 	TMap<uint32, TWeakObjectPtr<AActor>> TargetActors;
 	TMap<uint32, TWeakObjectPtr<UAdvancedSightComponent>> Listeners;
+	// Hot and cold query data are parallel arrays grouped by listener and sorted by target. Adding or removing queries
+	// only marks the layout dirty, it is regrouped before the next update.
 	TArray<FAdvancedSightQuery> Queries;
+	TArray<FAdvancedSightQueryColdData> QueriesColdData;
+	TMap<uint32, FAdvancedSightListenerQueries> ListenerQueries;
+	bool bIsQueryLayoutDirty = false;
+	TMap<uint32, FAdvancedSightTargetSnapshot> TargetSnapshots;
+	TMap<uint32, uint8> TargetCategories;
+	// Category changes usually come from perception delegates, which are broadcast while the queries are iterated
+	TSet<TWeakObjectPtr<const UAdvancedSightComponent>> PendingCategoryListeners;
+	TSet<TWeakObjectPtr<const AActor>> PendingCategoryTargets;
+	TArray<int32> ActiveQueryIndices;
+	// Parallel to ActiveQueryIndices, so the visibility pass does not need a map lookup per query
+	TArray<int32> ActiveQueryListenerIndices;
+	// Parallel to ActiveQueryIndices, results of the state update waiting to be dispatched
+	TArray<EAdvancedSightTransition> ActiveQueryTransitions;
+	TBitArray<> ActiveQueriesMoved;
+	// Every listener that is not dormant, also the ones outside of the current stagger group
+	TArray<FAdvancedSightActiveListener> ActiveListeners;
+	FAdvancedSightShardGrid ShardGrid;
+
+	TArray<TWeakObjectPtr<const UAdvancedSightIlluminationGrid>> IlluminationGrids;
+	TArray<TWeakObjectPtr<const UAdvancedSightLightComponent>> Lights;
+	FAdvancedSightIllumination Illumination;
+	TMap<FString, TUniquePtr<FAdvancedSightVisibilitySet>> LoadedVisibilitySets;
+	TArray<const FAdvancedSightVisibilitySet*> VisibilitySets;
+	FAdvancedSightTransmittanceTable TransmittanceTable;
+	TMap<TWeakObjectPtr<const UAdvancedSightOccluderComponent>, TArray<const UPrimitiveComponent*>> OccluderPrimitives;
+
+	TArray<TSharedRef<FAdvancedSenseBase>> Senses;
+	TSharedPtr<FAdvancedSenseHearing> HearingSense;
+	TArray<int32> SenseWorkItemOffsets;
+	TArray<FAdvancedSenseEvent> SenseEvents;
+	TArray<FAdvancedSightVisibilityRequest> PendingVisibilityRequests;
+	TArray<FAdvancedSightVisibilityRequest> VisibilityRequests;
+
+	uint8 NextStaggerSlot = 0;
+	int32 NextStaggerGroup = 0;
+	float UpdateAccumulator = 0.0f;
+
+	FSignificanceFunction SignificanceFunction;
+	TSet<uint32> DormantListeners;
+	TArray<FVector> PlayerPawnLocations;
+
+	FAdvancedSightPerceptionSnapshot PendingSnapshot;
+	double PendingSnapshotExpireTime = 0.0;
+	bool bShouldApplyPendingSnapshot = false;
+
+	TUniquePtr<FAdvancedSightRecorder> Recorder;
+	FAdvancedSightRecordedFrame RecordedFrame;
 
 	bool bShouldDebugDraw = false;
 	TWeakObjectPtr<const UAdvancedSightComponent> DebugListener;
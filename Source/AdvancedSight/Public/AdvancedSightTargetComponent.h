@@ -3,6 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "AdvancedSightData.h"
 #include "Components/ActorComponent.h"
 #include "AdvancedSightTargetComponent.generated.h"
 
@@ -17,8 +18,19 @@ public:
 	UAdvancedSightTargetComponent();
 	const TArray<USceneComponent*>& GetVisibilityPointComponents() const;
 	void GetVisibilityPoints(TArray<FVector>& VisibilityPoints) const;
+
+	// Only the queries of this target are added or removed, e.g. when a character dies and becomes a corpse
+	UFUNCTION(BlueprintCallable, Category = "AdvancedSight")
+	void SetCategories(
+		UPARAM(meta = (Bitmask, BitmaskEnum = "/Script/AdvancedSight.EAdvancedSightTargetCategory")) int32 InCategories);
+
+	UFUNCTION(BlueprintPure, Category = "AdvancedSight")
+	int32 GetCategories() const;
 protected:
 	virtual void BeginPlay() override;
+
+	UPROPERTY(EditAnywhere, Category = "AdvancedSight", meta = (Bitmask, BitmaskEnum = "/Script/AdvancedSight.EAdvancedSightTargetCategory"))
+	int32 Categories = static_cast<int32>(EAdvancedSightTargetCategory::Character);
 private:
 	UPROPERTY(Transient)
 	TArray<USceneComponent*> VisibilityPointComponents;
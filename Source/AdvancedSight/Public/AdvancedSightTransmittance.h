@@ -0,0 +1,24 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UPhysicalMaterial;
+class UPrimitiveComponent;
+struct FHitResult;
+
+// Transmittance of partially transparent geometry, resolved on the game thread so worker threads only do a lookup per
+// hit instead of reading the physical material or the occluder component
+struct ADVANCEDSIGHT_API FAdvancedSightTransmittanceTable
+{
+	TMap<const UPhysicalMaterial*, float> Materials;
+	TMap<const UPrimitiveComponent*, float> Components;
+
+	void Reset();
+	// Per component values win over the physical material one, returns false when the hit has neither
+	bool TryFind(const FHitResult& Hit, float& OutTransmittance) const;
+
+	static uint8 Quantize(const float Transmittance);
+	static float Dequantize(const uint8 QuantizedTransmittance);
+};
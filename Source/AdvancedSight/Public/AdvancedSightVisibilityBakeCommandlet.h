@@ -0,0 +1,23 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "AdvancedSightVisibilityBakeCommandlet.generated.h"
+
+class AAdvancedSightVisibilityVolume;
+
+// Bakes the potentially visible set of a map from the visibility volume in it, tracing between sample points of every
+// pair of cells against static geometry blocking the sight collision channel.
+// Usage: -run=AdvancedSightVisibilityBake -Map=<map package name>
+UCLASS()
+class ADVANCEDSIGHT_API UAdvancedSightVisibilityBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UAdvancedSightVisibilityBakeCommandlet();
+	virtual int32 Main(const FString& Params) override;
+
+	static bool BakeVolume(const UWorld* World, const AAdvancedSightVisibilityVolume* Volume, const FString& FilePath);
+};
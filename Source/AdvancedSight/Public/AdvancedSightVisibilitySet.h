@@ -0,0 +1,38 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSightGrid.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// Baked cell to cell visibility through the static geometry of a level, read straight from a memory mapped file.
+// Rows of cells that see the same set of cells are stored once, cells only keep an index into those unique rows.
+class ADVANCEDSIGHT_API FAdvancedSightVisibilitySet
+{
+public:
+	~FAdvancedSightVisibilitySet();
+
+	static FString GetFilePathForLevel(const FString& LevelPackageName);
+	static bool Write(
+		const FString& FilePath, const FAdvancedSightGridLayout& Layout, const TArray<TBitArray<>>& CellVisibility);
+
+	bool Open(const FString& FilePath);
+	void Close();
+	const FAdvancedSightGridLayout& GetLayout() const;
+	int32 GetNumUniqueRows() const;
+	// Returns INDEX_NONE outside of the baked grid
+	int32 GetCellIndex(const FVector& Location) const;
+	// Cells outside of the baked grid are always potentially visible
+	bool IsPotentiallyVisible(const int32 FromCellIndex, const int32 ToCellIndex) const;
+private:
+	TUniquePtr<IMappedFileHandle> MappedFileHandle;
+	TUniquePtr<IMappedFileRegion> MappedFileRegion;
+	FAdvancedSightGridLayout Layout;
+	const uint32* RowIndices = nullptr;
+	const uint32* Rows = nullptr;
+	int32 NumUniqueRows = 0;
+	int32 WordsPerRow = 0;
+};
@@ -0,0 +1,27 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Volume.h"
+#include "AdvancedSightVisibilityVolume.generated.h"
+
+// Bounds and settings of the potentially visible set baked for the level. Pairs of cells the static geometry always
+// separates are rejected by the sight system without tracing.
+UCLASS()
+class ADVANCEDSIGHT_API AAdvancedSightVisibilityVolume : public AVolume
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Visibility|Bake", meta = (ClampMin = "50.0", Units = "cm"))
+	float CellSize = 400.0f;
+
+	// Cells further apart are baked as not visible, so it must not be lower than the longest sight radius in the level
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Visibility|Bake", meta = (ClampMin = "0.0", Units = "cm"))
+	float MaxDistance = 10000.0f;
+
+	AAdvancedSightVisibilityVolume();
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+};
@@ -0,0 +1,51 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSightQuery.h"
+#include "BehaviorTree/BTDecorator.h"
+#include "BTDecorator_AdvancedSight.generated.h"
+
+class UAdvancedSightComponent;
+
+struct FBTAdvancedSightDecoratorMemory
+{
+	TWeakObjectPtr<UAdvancedSightComponent> SightComponent;
+	FDelegateHandle TransitionDelegateHandle;
+};
+
+// Passes when the sight component has any target in one of the selected states. Observer aborts are driven by the
+// component transition event, so the condition is never polled.
+UCLASS(meta = (DisplayName = "Advanced Sight"))
+class ADVANCEDSIGHT_API UBTDecorator_AdvancedSight : public UBTDecorator
+{
+	GENERATED_BODY()
+public:
+	UBTDecorator_AdvancedSight();
+
+	virtual uint16 GetInstanceMemorySize() const override;
+	virtual void InitializeMemory(
+		UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, EBTMemoryInit::Type InitType) const override;
+	virtual void CleanupMemory(
+		UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, EBTMemoryClear::Type CleanupType) const override;
+	virtual FString GetStaticDescription() const override;
+protected:
+	virtual bool CalculateRawConditionValue(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) const override;
+	virtual void OnBecomeRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+	virtual void OnCeaseRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+
+	void HandleTargetTransition(
+		AActor* TargetActor, EAdvancedSightTransition Transition, TWeakObjectPtr<UBehaviorTreeComponent> OwnerComp);
+
+	UPROPERTY(
+		EditAnywhere,
+		Category = "Condition",
+		meta = (Bitmask, BitmaskEnum = "/Script/AdvancedSight.EAdvancedSightTargetState"))
+	int32 TargetStates = static_cast<int32>(EAdvancedSightTargetState::Perceived);
+
+	// Restarts the branch whenever another target enters one of the selected states, instead of only aborting when
+	// the condition result changes
+	UPROPERTY(EditAnywhere, Category = "FlowControl")
+	bool bRestartOnNewTarget = false;
+};
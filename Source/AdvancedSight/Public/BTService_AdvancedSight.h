@@ -0,0 +1,66 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdvancedSightQuery.h"
+#include "BehaviorTree/BTService.h"
+#include "BTService_AdvancedSight.generated.h"
+
+class UAdvancedSightComponent;
+
+struct FBTAdvancedSightServiceMemory
+{
+	TWeakObjectPtr<UAdvancedSightComponent> SightComponent;
+	// Gains of the targets as reported by the component events, so ranking them does not look up their queries
+	TMap<TWeakObjectPtr<AActor>, float> TargetGains;
+	TWeakObjectPtr<AActor> TopTarget;
+	TWeakObjectPtr<AActor> LocationTarget;
+	float TopTargetGain = 0.0f;
+	FDelegateHandle TransitionDelegateHandle;
+	FDelegateHandle GainDelegateHandle;
+	FDelegateHandle LocationDelegateHandle;
+};
+
+// Writes the top target of the sight component, its last known location and gain into blackboard keys. It does not
+// tick, the keys are only updated from the component transition, gain and location events while the service is
+// relevant. Transitions pick the top target again, gain and location events only touch the keys of their target.
+UCLASS(meta = (DisplayName = "Advanced Sight"))
+class ADVANCEDSIGHT_API UBTService_AdvancedSight : public UBTService
+{
+	GENERATED_BODY()
+public:
+	UBTService_AdvancedSight();
+
+	virtual void InitializeFromAsset(UBehaviorTree& Asset) override;
+	virtual uint16 GetInstanceMemorySize() const override;
+	virtual void InitializeMemory(
+		UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, EBTMemoryInit::Type InitType) const override;
+	virtual void CleanupMemory(
+		UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, EBTMemoryClear::Type CleanupType) const override;
+	virtual FString GetStaticDescription() const override;
+protected:
+	virtual void OnBecomeRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+	virtual void OnCeaseRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+
+	void HandleTargetTransition(
+		AActor* TargetActor, EAdvancedSightTransition Transition, TWeakObjectPtr<UBehaviorTreeComponent> OwnerComp);
+	void HandleTargetGainChanged(AActor* TargetActor, float GainValue, TWeakObjectPtr<UBehaviorTreeComponent> OwnerComp);
+	void HandleTargetLastSeenLocationChanged(
+		AActor* TargetActor, const FVector& Location, TWeakObjectPtr<UBehaviorTreeComponent> OwnerComp);
+	FBTAdvancedSightServiceMemory* FindServiceMemory(UBehaviorTreeComponent& OwnerComp);
+	void UnbindSightComponent(FBTAdvancedSightServiceMemory& Memory) const;
+	void SelectTopTarget(const UAdvancedSightComponent& SightComponent, FBTAdvancedSightServiceMemory& Memory) const;
+	void UpdateBlackboard(UBehaviorTreeComponent& OwnerComp, const FBTAdvancedSightServiceMemory& Memory) const;
+
+	// Perceived targets win over spotted ones, ties are broken by the highest gain
+	UPROPERTY(EditAnywhere, Category = "Blackboard")
+	FBlackboardKeySelector TargetActorKey;
+
+	// Last known location of the top target or, without one, of a remembered target
+	UPROPERTY(EditAnywhere, Category = "Blackboard")
+	FBlackboardKeySelector LastKnownLocationKey;
+
+	UPROPERTY(EditAnywhere, Category = "Blackboard")
+	FBlackboardKeySelector GainKey;
+};
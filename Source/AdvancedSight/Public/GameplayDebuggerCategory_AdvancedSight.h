@@ -0,0 +1,30 @@
+﻿// Copyright 2024, Robert Lewicki, All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_GAMEPLAY_DEBUGGER
+
+#include "GameplayDebuggerCategory.h"
+
+class APlayerController;
+class AActor;
+struct FAdvancedSightCone;
+
+// Lists every sight listener around the debug actor and draws the closest ones using batched, replicated shapes
+// built from the sight system state of the last tick, so it works the same on dedicated servers.
+class ADVANCEDSIGHT_API FGameplayDebuggerCategory_AdvancedSight : public FGameplayDebuggerCategory
+{
+public:
+	FGameplayDebuggerCategory_AdvancedSight();
+
+	static TSharedRef<FGameplayDebuggerCategory> MakeInstance();
+
+	virtual void CollectData(APlayerController* OwnerPC, AActor* DebugActor) override;
+protected:
+	// Outlines the cone in its actual shape, following its horizontal and vertical extent
+	void AddConeShapes(const FAdvancedSightCone& Cone, const FVector& EyeLocation, const FVector& EyeForward);
+};
+
+#endif // WITH_GAMEPLAY_DEBUGGER